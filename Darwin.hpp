@@ -3,9 +3,40 @@
 
 #include <iostream>
 #include <vector>
+#include <deque>
+#include <array>
+#include <utility>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <cstdint>
+#include <bit>
+#include <stdexcept>
+#include <string_view>
+#include <charconv>
+#include <fstream>
+#include <filesystem>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <exception>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DARWIN_MMAP 1
+#endif
 
 using namespace std;
 
@@ -14,6 +45,57 @@ class Creature;
 class Species;
 class Darwin;
 
+// a flat row-major board with a one cell wall border all the way around it,
+// so looking one step off the edge lands on a wall instead of out of bounds
+template <typename T>
+class Grid {
+public:
+
+    // fills the inside with the empty value and the border with the wall value
+    Grid(int r, int c, T empty, T wall)
+        : rows(r), cols(c), stride(c + 2), cells(static_cast<size_t>(r + 2) * (c + 2), wall) {
+        for (int i = 0; i < rows; i++) {
+            fill(cells.begin() + index(i, 0), cells.begin() + index(i, 0) + cols, empty);
+        }
+    }
+
+    // where (row, col) lives in the padded array
+    int index(int row, int col) const {
+        return (row + 1) * stride + col + 1;
+    }
+
+    // how far apart two vertically neighbouring cells are
+    int get_stride() const {
+        return stride;
+    }
+
+    int get_rows() const {
+        return rows;
+    }
+    int get_cols() const {
+        return cols;
+    }
+
+    T& operator[](int i) {
+        return cells[i];
+    }
+    const T& operator[](int i) const {
+        return cells[i];
+    }
+
+    // the whole padded array, border included
+    vector<T>& data() {
+        return cells;
+    }
+    const vector<T>& data() const {
+        return cells;
+    }
+
+private:
+    int rows, cols, stride;
+    vector<T> cells;
+};
+
 // Instruction class to represent each instruction in a species program
 class Instruction {
 
@@ -21,322 +103,3268 @@ public:
     // the different types of instructions to know what to do next by category
     enum Type { HOP, LEFT, RIGHT, INFECT, IF_EMPTY, IF_WALL, IF_RANDOM, IF_ENEMY, GO };
 
+    // how .spc files spell them
+    static constexpr string_view NAMES[] = {
+        "hop", "left", "right", "infect", "if_empty", "if_wall", "if_random", "if_enemy", "go"
+    };
+
     // takes in an enum type and a parameter
     // doesn't make an extra copy
-    Instruction(Type t, int n = 0) : type(t), param(n) {}
+    constexpr Instruction(Type t, int n = 0) : type(t), param(n) {}
 
     Type type;
     int param;
 };
 
-// Species class to represent a type of creature and its program
-class Species {
-public:
-    // dafault constructor
-    Species() = default;
+// the species run_Darwin ships with, kept here as constants so Darwin can
+// generate an interpreter for each one at compile time
+namespace builtin {
 
-    void add_instruction(Instruction::Type type, int param = 0) {
-        program.push_back(Instruction(type, param));
-    }
+inline constexpr array<Instruction, 2> FOOD = {{
+    {Instruction::LEFT}, {Instruction::GO, 0}
+}};
 
-    // returns the set of instructions
-    const vector<Instruction>& get_program() const {
-        return program;
+inline constexpr array<Instruction, 2> HOPPER = {{
+    {Instruction::HOP}, {Instruction::GO, 0}
+}};
+
+inline constexpr array<Instruction, 11> ROVER = {{
+    {Instruction::IF_ENEMY, 9}, {Instruction::IF_EMPTY, 7}, {Instruction::IF_RANDOM, 5},
+    {Instruction::LEFT}, {Instruction::GO, 0}, {Instruction::RIGHT}, {Instruction::GO, 0},
+    {Instruction::HOP}, {Instruction::GO, 0}, {Instruction::INFECT}, {Instruction::GO, 0}
+}};
+
+inline constexpr array<Instruction, 5> TRAP = {{
+    {Instruction::IF_ENEMY, 3}, {Instruction::LEFT}, {Instruction::GO, 0},
+    {Instruction::INFECT}, {Instruction::GO, 0}
+}};
+
+// the first non GO instruction reachable from pc, same as compile() does it
+template <size_t N>
+constexpr int landing(const array<Instruction, N>& program, int pc) {
+    for (size_t steps = 0; steps < N && program[pc].type == Instruction::GO; steps++) {
+        pc = program[pc].param;
     }
+    return pc;
+}
 
-private:
-    vector<Instruction> program;
-};
+template <size_t N>
+bool same_program(const vector<Instruction>& program, const array<Instruction, N>& code) {
+    return program.size() == N && equal(code.begin(), code.end(), program.begin(), [](const Instruction& a, const Instruction& b) {
+        return a.type == b.type && a.param == b.param;
+    });
+}
 
-// an individual creature of some sort of Species
-class Creature {
+}
+
+// which cells of a grid have a creature on them, one bit per cell plus one
+// bit per 64 cells on top, so finding the next creature in row-major order
+// skips empty stretches of board 4096 cells at a time
+class CellSet {
 public:
 
-    // initializes with a species name, it's individual pointer to the species' instruction, and a cahracter for
-    // the direction
-    Creature(const string& species_name, const Species* sp, char dir)
-        : species_type(species_name), species(sp), direction(dir),
-          program_counter(0), last_moved_turn(-1) {}
+    explicit CellSet(int size = 0)
+        : words((size + 63) / 64, 0), summary((size + 4095) / 4096 + 1, 0) {}
 
-    bool execute_turn(Darwin& world, int row, int col, int current_turn);
+    void insert(int i) {
+        words[i >> 6] |= uint64_t(1) << (i & 63);
+        summary[i >> 12] |= uint64_t(1) << ((i >> 6) & 63);
+    }
 
-    // gets the information for the species type and direction
-    string get_species_type() const {
-        return species_type;
+    void erase(int i) {
+        words[i >> 6] &= ~(uint64_t(1) << (i & 63));
+        if (!words[i >> 6]) {
+            summary[i >> 12] &= ~(uint64_t(1) << ((i >> 6) & 63));
+        }
     }
-    char get_direction() const {
-        return direction;
+
+    bool contains(int i) const {
+        return (words[i >> 6] >> (i & 63)) & 1;
     }
 
-    // to change the species upon infection
-    void set_species(const std::string& new_species_name, const Species* new_species) {
-        species_type = new_species_name;
-        species = new_species;
-        program_counter = 0;
+    // the first cell at or after i that's in the set, -1 if there isn't one
+    int next(int i) const {
+        int w = i >> 6;
+        if (w >= static_cast<int>(words.size())) {
+            return -1;
+        }
+        const uint64_t here = words[w] & (~uint64_t(0) << (i & 63));
+        if (here) {
+            return (w << 6) + countr_zero(here);
+        }
+        // jump to the next non empty word using the summary
+        w++;
+        int s = w >> 6;
+        if (s >= static_cast<int>(summary.size())) {
+            return -1;
+        }
+        uint64_t pending = (w & 63) ? summary[s] & (~uint64_t(0) << (w & 63)) : summary[s];
+        while (!pending) {
+            if (++s == static_cast<int>(summary.size())) {
+                return -1;
+            }
+            pending = summary[s];
+        }
+        w = (s << 6) + countr_zero(pending);
+        return (w << 6) + countr_zero(words[w]);
     }
 
 private:
-    string species_type;
-    const Species* species;
-    char direction;
-    int program_counter;
-    int last_moved_turn;
-
-    void turn_left();
-    void turn_right();
-    bool can_move_forward(const Darwin& world, int row, int col) const;
-    void get_forward_position(int row, int col, int& next_row, int& next_col) const;
-    bool is_enemy_ahead(const Darwin& world, int row, int col) const;
+    vector<uint64_t> words;
+    vector<uint64_t> summary;
 };
 
-// the main program for Darwin
-class Darwin {
+// a few threads kept around to run the same kind of job over and over.
+// run(job) calls job(0) to job(size() - 1) at once, taking job(0) on the
+// calling thread, and returns when they've all finished
+class WorkerPool {
 public:
 
-    // to initialize the board "pseudo-randomly"
-    Darwin(int r, int c) : rows(r), cols(c), grid(r, vector<Creature*>(c, nullptr)) {
-        srand(0);
+    explicit WorkerPool(int n) {
+        for (int i = 1; i < n; i++) {
+            workers.emplace_back([this, i]() {
+                work(i);
+            });
+        }
     }
 
-    // add species to the Darwin that is able to pop up or not
-    void add_species(const string& name, const Species& species) {
-        species_map[name] = species;
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        stopping = true;
+        generation.fetch_add(1, memory_order_release);
+        generation.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
     }
 
-    // add a creature to the board, and given a default orientation
-    void add_creature(const string& species_name, int row, int col, char dir) {
-        if (row >= 0 && row < rows && col >= 0 && col < cols) {
-            delete grid[row][col];
-            grid[row][col] = new Creature(species_name, &species_map[species_name], dir);
+    int size() const {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    void run(const function<void(int)>& f) {
+        job = &f;
+        pending.store(static_cast<int>(workers.size()), memory_order_relaxed);
+        generation.fetch_add(1, memory_order_release);
+        generation.notify_all();
+        f(0);
+        for (int left = pending.load(memory_order_acquire); left > 0; left = pending.load(memory_order_acquire)) {
+            pending.wait(left, memory_order_acquire);
         }
     }
 
-    // runs the basis of the simulation for the board given how many turns
-    // and how frequently it wants to be printed
-    void simulate(int turns, int freq, int numOfTests, int totalNumOfTests) {
-        cout << "*** Darwin " << rows << "x" << cols << " ***" << endl;
-        print_grid(0, false, false);
-        // cout << "turns: " << turns << "\t frequency: " << freq << "\n";
-        int totalPrints = turns/freq;
-        int printing = 1;
+private:
+    vector<thread> workers;
+    const function<void(int)>* job = nullptr;
+    atomic<unsigned> generation {0};
+    atomic<int> pending {0};
+    atomic<bool> stopping {false};
 
-        for (int turn = 1; turn <= turns; turn++) {
-            for (int i = 0; i < rows; i++) {
-                for (int j = 0; j < cols; j++) {
-                    if (grid[i][j]) {
-                        grid[i][j]->execute_turn(*this, i, j, turn);
-                    }
-                }
+    // every job is waited on before the next one starts, so a worker sees
+    // each generation exactly once
+    void work(int i) {
+        for (unsigned seen = 0;;) {
+            generation.wait(seen, memory_order_acquire);
+            seen = generation.load(memory_order_acquire);
+            if (stopping) {
+                return;
             }
-
-            // cout << "total prints: " << totalPrints << "\t printing int: " << printing << "\n";
-            bool toPrintEndline1 = (totalNumOfTests == (numOfTests+1));
-            bool toPrintEndline2 = (printing == (totalPrints));
-            // cout << "total prints equals the currenting printing tracker? " << toPrintEndline2 << "\n";
-            // cout << "testcases match? " << toPrintEndline1 << "\t last turn of simulation printing? " << toPrintEndline2 << "\n";
-            if (turn % freq == 0) {
-                // cout<< "total test cases: " << totalNumOfTests << "\t current testcase: " << numOfTests << "\n";
-                print_grid(turn, toPrintEndline1, toPrintEndline2);
-                printing++;
+            (*job)(i);
+            if (pending.fetch_sub(1, memory_order_acq_rel) == 1) {
+                pending.notify_one();
             }
         }
     }
+};
 
-    // checks if the propsed row and column exists on the board
-    bool is_valid_position(int row, int col) const {
-        return row >= 0 && row < rows && col >= 0 && col < cols;
+// the computed goto interpreter needs the GNU labels-as-values extension
+#if !defined(DARWIN_THREADED) && defined(__GNUC__)
+#define DARWIN_THREADED 1
+#endif
+
+// the board kernels use GCC's vector extensions, 32 bytes at a time with
+// AVX2 (-march=native) and 16 with plain SSE2, vectors wider than the
+// target has get split up badly
+#if !defined(DARWIN_SIMD) && defined(__GNUC__) && !defined(__clang__)
+#define DARWIN_SIMD 1
+#endif
+
+// whole rows at once over a byte per cell copy of the board: 0 for an empty
+// cell, WALL_CODE for the border and species id + 1 for a creature
+namespace kernels {
+
+// what's in front of a cell, in the same order Species::analyze() goes
+// through them
+enum Sense : uint8_t { WALL, EMPTY, ENEMY, FRIEND };
+
+constexpr uint8_t WALL_CODE = 0xff;
+
+// species ids that still fit in a byte next to the empty and wall codes
+constexpr int MAX_SPECIES = 254;
+
+inline void sense_row_scalar(const uint8_t* here, const uint8_t* ahead, int n, uint8_t* out) {
+    for (int j = 0; j < n; j++) {
+        out[j] = ahead[j] == WALL_CODE ? WALL : ahead[j] == 0 ? EMPTY : ahead[j] == here[j] ? FRIEND : ENEMY;
     }
+}
 
-    // gets a local lil critter
-    Creature* get_creature(int row, int col) const {
-        if (is_valid_position(row, col)) {
-            return grid[row][col];
-        }
-        return nullptr;
+inline void glyph_row_scalar(const uint8_t* codes, int n, const char* palette, char* out) {
+    for (int j = 0; j < n; j++) {
+        out[j] = palette[codes[j]];
     }
+}
 
-    // moves the creature from one space to another if the position is valid
-    void move_creature(int from_row, int from_col, int to_row, int to_col) {
-        if (is_valid_position(from_row, from_col) && is_valid_position(to_row, to_col)) {
-            grid[to_row][to_col] = grid[from_row][from_col];
-            grid[from_row][from_col] = nullptr;
-        }
+#if DARWIN_SIMD
+#ifdef __AVX2__
+constexpr int WIDTH = 32;
+#else
+constexpr int WIDTH = 16;
+#endif
+using Bytes = uint8_t __attribute__((vector_size(WIDTH)));
+#endif
+
+// out[j] is what cell here[j] sees in ahead[j], ahead being here shifted by
+// the offset of one direction. nothing has to be in the cell for it to work
+inline void sense_row(const uint8_t* here, const uint8_t* ahead, int n, uint8_t* out) {
+    int j = 0;
+#if DARWIN_SIMD
+    for (; j + WIDTH <= n; j += WIDTH) {
+        Bytes h, a;
+        memcpy(&h, here + j, sizeof(h));
+        memcpy(&a, ahead + j, sizeof(a));
+        const Bytes empty = Bytes(a == 0);
+        const Bytes wall = Bytes(a == WALL_CODE);
+        Bytes r = (Bytes(a == h) & 1) + uint8_t(ENEMY);     // FRIEND is ENEMY + 1
+        r = (r & ~empty) | (empty & uint8_t(EMPTY));
+        r &= ~wall;                                         // WALL is 0
+        memcpy(out + j, &r, sizeof(r));
     }
+#endif
+    sense_row_scalar(here + j, ahead + j, n - j, out + j);
+}
 
-    // cleans up the board
-    ~Darwin() {
-        for (auto& row : grid) {
-            for (auto creature : row) {
-                delete creature;
-            }
+// out[j] is palette[codes[j]], palette has an entry for every code. with no
+// more colors than two vectors hold that's a byte shuffle per vector of
+// cells, which needs SSSE3's pshufb to beat the plain loop
+inline void glyph_row(const uint8_t* codes, int n, const char* palette, [[maybe_unused]] int colors, char* out) {
+    int j = 0;
+#if DARWIN_SIMD && defined(__SSSE3__)
+    if (colors <= 2 * WIDTH) {
+        Bytes low, high;
+        memcpy(&low, palette, sizeof(low));
+        memcpy(&high, palette + WIDTH, sizeof(high));
+        for (; j + WIDTH <= n; j += WIDTH) {
+            Bytes g;
+            memcpy(&g, codes + j, sizeof(g));
+            g = __builtin_shuffle(low, high, g);
+            memcpy(out + j, &g, sizeof(g));
         }
     }
+#endif
+    glyph_row_scalar(codes + j, n - j, palette, out + j);
+}
 
-private:
+}
 
-    // prints the grid
-    int rows, cols;
-    vector<vector<Creature*>> grid;
-    map<string, Species> species_map;
+// what a run did, counted as it goes. the counting is only compiled in with
+// DARWIN_STATS defined, without it every counter stays at zero. each world
+// counts on its own, so threads running different worlds never share a
+// counter, and merge() adds them up once they're done. turns that fast
+// forward or cycle detection skip are counted as if they'd been run
+struct Stats {
+    uint64_t ops[Instruction::GO + 1] = {};  // instructions interpreted, by opcode
+    uint64_t actions = 0;                    // creature turns that ended in an action
+    uint64_t hops_blocked = 0;               // HOPs with something in the way
+    uint64_t infections = 0;                 // INFECTs that changed a creature's species
+    int first_turn = 1;                      // the turn population starts at
+    vector<string> species;                  // names by species id
+    vector<vector<int>> population;          // per turn, the count of each species after it
 
-    void print_grid(int turn, bool lastTestCase, bool lastTurn) const {
-        cout << "Turn = " << turn << "." << endl;
-        cout << "  ";
-        for (int j = 0; j < cols; j++) {
-            cout << j % 10;
+    uint64_t instructions() const {
+        uint64_t n = 0;
+        for (uint64_t count : ops) {
+            n += count;
         }
-        cout << endl;
+        return n;
+    }
 
-        for (int i = 0; i < rows; i++) {
-            cout << i % 10 << " ";
-            for (int j = 0; j < cols; j++) {
-                cout << (grid[i][j] ? grid[i][j]->get_species_type()[0] : '.');
-            }
-            cout << endl;
+    // adds up the counters, populations are per world so they stay out of it
+    void merge(const Stats& other) {
+        for (int op = 0; op <= Instruction::GO; op++) {
+            ops[op] += other.ops[op];
         }
-        // cout << "is this last testcase? " << lastTestCase << "\t is this last turn of printing? " << lastTurn << "\n";
-        if (!lastTestCase || (!lastTurn && lastTestCase))
-        {
-            cout << endl;
+        actions += other.actions;
+        hops_blocked += other.hops_blocked;
+        infections += other.infections;
+    }
+
+    // just the counters, without the names and populations
+    Stats counters() const {
+        Stats copy;
+        copy.merge(*this);
+        return copy;
+    }
+
+    // adds what the counters did between two snapshots of them, times over,
+    // for turns that were skipped instead of run
+    void repeat(const Stats& from, const Stats& to, uint64_t times) {
+        for (int op = 0; op <= Instruction::GO; op++) {
+            ops[op] += (to.ops[op] - from.ops[op]) * times;
         }
+        actions += (to.actions - from.actions) * times;
+        hops_blocked += (to.hops_blocked - from.hops_blocked) * times;
+        infections += (to.infections - from.infections) * times;
     }
 };
 
-// these changes the orientation of the creature and marks it accordingly
-void Creature::turn_left() {
-    if (direction == 'n') direction = 'w';
-    else if (direction == 'w') direction = 's';
-    else if (direction == 's') direction = 'e';
-    else if (direction == 'e') direction = 'n';
-}
+#ifdef DARWIN_STATS
+#define DARWIN_COUNT(...) do { __VA_ARGS__; } while (0)
+#else
+#define DARWIN_COUNT(...) do { } while (0)
+#endif
 
-void Creature::turn_right() {
-    if (direction == 'n') direction = 'e';
-    else if (direction == 'e') direction = 's';
-    else if (direction == 's') direction = 'w';
-    else if (direction == 'w') direction = 'n';
-}
+// a species program flattened for the interpreter, every op is one word holding
+// the opcode and both places it can go next, with GO chains and the wrap back
+// to the top already followed
+class Bytecode {
+public:
 
-// gets the next position based on what direction it's facing
-void Creature::get_forward_position(int row, int col, int& next_row, int& next_col) const {
-    next_row = row;
-    next_col = col;
+    // the targets get 14 bits each
+    static constexpr int MAX_SIZE = 1 << 14;
 
-    if (direction == 'n') next_row--;
-    else if (direction == 's') next_row++;
-    else if (direction == 'e') next_col++;
-    else if (direction == 'w') next_col--;
-}
+    static uint32_t pack(int op, int taken, int next) {
+        return static_cast<uint32_t>(op) | static_cast<uint32_t>(taken) << 4 | static_cast<uint32_t>(next) << 18;
+    }
 
-// checks if the position it wants to move forward in is a valid place to move
-bool Creature::can_move_forward(const Darwin& world, int row, int col) const {
-    int next_row, next_col;
-    get_forward_position(row, col, next_row, next_col);
-    return world.is_valid_position(next_row, next_col) &&
-           world.get_creature(next_row, next_col) == nullptr;
-}
+    // what the op does
+    static int op(uint32_t word) {
+        return word & 15;
+    }
+    // where a test that passed (or a GO) jumps to
+    static int taken(uint32_t word) {
+        return (word >> 4) & (MAX_SIZE - 1);
+    }
+    // where to carry on after an action or a test that failed
+    static int next(uint32_t word) {
+        return word >> 18;
+    }
 
-// checks if there's an 'enemy' in front of the creature based on what direction it's
-// facing
-bool Creature::is_enemy_ahead(const Darwin& world, int row, int col) const {
-    int next_row, next_col;
-    get_forward_position(row, col, next_row, next_col);
+    uint32_t operator[](int pc) const {
+        return code[pc];
+    }
+    int size() const {
+        return static_cast<int>(code.size());
+    }
+    bool empty() const {
+        return code.empty();
+    }
 
-    if (!world.is_valid_position(next_row, next_col)) return false;
+    vector<uint32_t> code;
+};
 
-    Creature* ahead = world.get_creature(next_row, next_col);
-    return ahead && ahead->get_species_type() != species_type;
-}
+// Species class to represent a type of creature and its program
+class Species {
+public:
+    // dafault constructor
+    Species() = default;
 
-// checks if a creature has had its turn
-bool Creature::execute_turn(Darwin& world, int row, int col, int current_turn) {
-    if (last_moved_turn == current_turn) {
-        return false;  // Already moved this turn
+    // one of the builtin:: programs
+    template <size_t N>
+    explicit Species(const array<Instruction, N>& code) : program(code.begin(), code.end()) {}
+
+    void add_instruction(Instruction::Type type, int param = 0) {
+        program.push_back(Instruction(type, param));
     }
 
-    bool took_action = false;
-    while (!took_action) {
+    // returns the set of instructions
+    const vector<Instruction>& get_program() const {
+        return program;
+    }
 
-        // checks through the different instruction types (enums) and executes the appropriate one
-        // for the creature using the program counter
-        const Instruction& inst = species->get_program()[program_counter];
+    // turns the instructions into bytecode, throws if a jump goes nowhere
+    Bytecode compile() const;
 
-        switch (inst.type) {
-        case Instruction::HOP: {
-            if (can_move_forward(world, row, col)) {
-                int next_row, next_col;
-                get_forward_position(row, col, next_row, next_col);
-                world.move_creature(row, col, next_row, next_col);
-            }
-            took_action = true;
-            break;
+    // reads a program written one instruction per line, like "if_enemy 9",
+    // blank lines and anything after a '#' are skipped, throws
+    // invalid_argument naming the source and line on anything else
+    static Species parse(string_view text, const string& source = "species");
+
+    // parse() on the whole contents of a .spc file
+    static Species load(const string& path);
+
+    // what analyze() found out about a program
+    struct Analysis {
+        vector<string> errors;  // empty if the program is safe to run
+        vector<int> chain;      // per pc, the most tests and GOs that can run before an action, -1 if it can spin forever
+        int max_chain = 0;      // the worst of those over everything reachable from the top
+
+        bool ok() const {
+            return errors.empty();
         }
+    };
 
-        case Instruction::LEFT:
-            turn_left();
-            took_action = true;
-            break;
+    // checks the jumps and makes sure every turn ends in an action no matter
+    // what's in front of the creature or how the coin flips come out
+    Analysis analyze() const;
 
-        case Instruction::RIGHT:
-            turn_right();
-            took_action = true;
-            break;
+private:
+    vector<Instruction> program;
+};
+
+inline Species Species::parse(string_view text, const string& source) {
+    const auto& names = Instruction::NAMES;
 
-        case Instruction::INFECT: {
-            int next_row, next_col;
-            get_forward_position(row, col, next_row, next_col);
-            if (is_enemy_ahead(world, row, col)) {
-                Creature* enemy = world.get_creature(next_row, next_col);
-                enemy->set_species(species_type, species);
+    // instruction names aren't case sensitive
+    auto same_word = [](string_view word, string_view name) {
+        if (word.size() != name.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < word.size(); i++) {
+            if (tolower(static_cast<unsigned char>(word[i])) != name[i]) {
+                return false;
             }
-            took_action = true;
-            break;
         }
+        return true;
+    };
 
+    Species species;
+    int line = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == string_view::npos) {
+            end = text.size();
+        }
+        string_view rest = text.substr(pos, end - pos);
+        pos = end + 1;
+        line++;
 
-
-        case Instruction::IF_EMPTY:
-            if (can_move_forward(world, row, col)) {
-                program_counter = inst.param;
-                continue;
+        auto fail = [&](const string& why) {
+            throw invalid_argument(source + ":" + to_string(line) + ": " + why);
+        };
+        auto skip_blanks = [&]() {
+            while (!rest.empty() && (rest.front() == ' ' || rest.front() == '\t' || rest.front() == '\r')) {
+                rest.remove_prefix(1);
             }
-            break;
+        };
+        auto next_word = [&]() {
+            skip_blanks();
+            size_t n = 0;
+            while (n < rest.size() && rest[n] != ' ' && rest[n] != '\t' && rest[n] != '\r' && rest[n] != '#') {
+                n++;
+            }
+            string_view word = rest.substr(0, n);
+            rest.remove_prefix(n);
+            return word;
+        };
 
-        case Instruction::IF_WALL: {
-            int next_row, next_col;
-            get_forward_position(row, col, next_row, next_col);
-            if (!world.is_valid_position(next_row, next_col)) {
-                program_counter = inst.param;
-                continue;
+        string_view word = next_word();
+        if (word.empty()) {
+            continue;
+        }
+
+        int type = 0;
+        while (type < 9 && !same_word(word, names[type])) {
+            type++;
+        }
+        if (type == 9) {
+            fail("unknown instruction \"" + string(word) + "\"");
+        }
+
+        int param = 0;
+        string_view number = next_word();
+        if (type >= Instruction::IF_EMPTY) {
+            if (number.empty()) {
+                fail(string(names[type]) + " needs a target");
             }
-            break;
+            auto [ptr, ec] = from_chars(number.data(), number.data() + number.size(), param);
+            if (ec != errc() || ptr != number.data() + number.size()) {
+                fail("bad target \"" + string(number) + "\"");
+            }
+        } else if (!number.empty()) {
+            fail(string(names[type]) + " doesn't take a target");
+        }
+        if (!next_word().empty()) {
+            fail("unexpected text after the instruction");
         }
+        species.add_instruction(static_cast<Instruction::Type>(type), param);
+    }
+    return species;
+}
 
-        case Instruction::IF_RANDOM:
-            if (rand() % 2) {
-                program_counter = inst.param;
-                continue;
+inline Species Species::load(const string& path) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        throw invalid_argument(path + ": can't open species file");
+    }
+    ostringstream text;
+    text << in.rdbuf();
+    return parse(text.str(), path);
+}
+
+inline Species::Analysis Species::analyze() const {
+    Analysis result;
+    const int size = static_cast<int>(program.size());
+    if (size == 0) {
+        result.errors.push_back("program is empty");
+        return result;
+    }
+    for (int i = 0; i < size; i++) {
+        if (program[i].type >= Instruction::IF_EMPTY && (program[i].param < 0 || program[i].param >= size)) {
+            result.errors.push_back("instruction " + to_string(i) + " jumps to " + to_string(program[i].param) +
+                                    " in a program of " + to_string(size));
+        }
+    }
+    if (!result.ok()) {
+        return result;
+    }
+
+    // what can be in front of a creature, it stays the same for a whole turn
+    // so each test always comes out the same way until an action happens
+    enum Ahead { WALL, EMPTY, ENEMY, FRIEND };
+    auto holds = [](Instruction::Type type, int ahead) {
+        return (type == Instruction::IF_EMPTY && ahead == EMPTY) ||
+               (type == Instruction::IF_WALL && ahead == WALL) ||
+               (type == Instruction::IF_ENEMY && ahead == ENEMY);
+    };
+
+    result.chain.assign(size, 0);
+    vector<int> state(size), longest(size);
+    for (int ahead = WALL; ahead <= FRIEND; ahead++) {
+        fill(state.begin(), state.end(), 0);
+
+        // longest run of non actions from pc, -1 if it can go round in circles
+        auto walk = [&](auto& self, int pc) -> int {
+            if (state[pc] == 1) {
+                return -1;
             }
-            break;
+            if (state[pc] == 2) {
+                return longest[pc];
+            }
+            const Instruction& inst = program[pc];
+            if (inst.type < Instruction::IF_EMPTY) {
+                state[pc] = 2;
+                return longest[pc] = 0;
+            }
+            state[pc] = 1;
+            const int next = (pc + 1) % size;
+            int steps;
+            if (inst.type == Instruction::GO) {
+                steps = self(self, inst.param);
+            } else if (inst.type == Instruction::IF_RANDOM) {
+                const int a = self(self, inst.param);
+                const int b = self(self, next);
+                steps = a < 0 || b < 0 ? -1 : max(a, b);
+            } else {
+                steps = self(self, holds(inst.type, ahead) ? inst.param : next);
+            }
+            state[pc] = 2;
+            return longest[pc] = steps < 0 ? -1 : steps + 1;
+        };
 
-        case Instruction::IF_ENEMY:
-            if (is_enemy_ahead(world, row, col)) {
-                program_counter = inst.param;
-                continue;
+        for (int pc = 0; pc < size; pc++) {
+            const int steps = walk(walk, pc);
+            if (result.chain[pc] >= 0) {
+                result.chain[pc] = steps < 0 ? -1 : max(result.chain[pc], steps);
             }
-            break;
+        }
+    }
 
-        case Instruction::GO:
-            program_counter = inst.param;
+    // only what the creature can actually get to from the top matters
+    vector<bool> seen(size, false);
+    vector<int> todo = {0};
+    seen[0] = true;
+    while (!todo.empty()) {
+        const int pc = todo.back();
+        todo.pop_back();
+        const Instruction& inst = program[pc];
+        const int next = (pc + 1) % size;
+        for (int to : {inst.type >= Instruction::IF_EMPTY ? inst.param : next, inst.type == Instruction::GO ? inst.param : next}) {
+            if (!seen[to]) {
+                seen[to] = true;
+                todo.push_back(to);
+            }
+        }
+    }
+    for (int pc = 0; pc < size; pc++) {
+        if (!seen[pc]) {
             continue;
         }
+        if (result.chain[pc] < 0) {
+            result.errors.push_back("instruction " + to_string(pc) + " can loop forever without taking an action");
+        } else {
+            result.max_chain = max(result.max_chain, result.chain[pc]);
+        }
+    }
+    return result;
+}
 
-        // Increment program counter and wrap around if necessary
-        program_counter = (program_counter + 1) % species->get_program().size();
+inline Bytecode Species::compile() const {
+    const int size = static_cast<int>(program.size());
+    if (size > Bytecode::MAX_SIZE) {
+        throw length_error("species program has more than " + to_string(Bytecode::MAX_SIZE) + " instructions");
+    }
+    for (int i = 0; i < size; i++) {
+        if (program[i].type >= Instruction::IF_EMPTY && (program[i].param < 0 || program[i].param >= size)) {
+            throw out_of_range("instruction " + to_string(i) + " jumps to " + to_string(program[i].param) +
+                               " in a program of " + to_string(size));
+        }
     }
 
-    last_moved_turn = current_turn;
-    return true;
+    // lands on the first non GO instruction reachable from pc, a loop made of
+    // nothing but GOs stays where it is
+    auto resolve = [&](int pc) {
+        for (int steps = 0; steps < size && program[pc].type == Instruction::GO; steps++) {
+            pc = program[pc].param;
+        }
+        return pc;
+    };
+
+    Bytecode bytecode;
+    bytecode.code.reserve(size);
+    for (int i = 0; i < size; i++) {
+        const Instruction& inst = program[i];
+        const int next = resolve((i + 1) % size);
+        const int taken = inst.type >= Instruction::IF_EMPTY ? resolve(inst.param) : next;
+        bytecode.code.push_back(Bytecode::pack(inst.type, taken, inst.type == Instruction::GO ? taken : next));
+    }
+    return bytecode;
+}
+
+// hands out a small dense id for every species name in a world, so creatures
+// carry an integer and comparing or drawing species never touches a string
+class SpeciesRegistry {
+public:
+
+    // stores (or replaces) the program for a name and returns its id
+    int define(const string& name, const Species& species) {
+        Bytecode bytecode = species.compile();
+        const Species::Analysis analysis = species.analyze();
+        if (!analysis.ok()) {
+            throw invalid_argument("species " + name + ": " + analysis.errors.front());
+        }
+        const int id = intern(name);
+        programs[id] = species;
+        compiled[id] = move(bytecode);
+        limits[id] = analysis.max_chain;
+        uses[id] = 0;
+        for (const Instruction& inst : species.get_program()) {
+            uses[id] |= 1u << inst.type;
+        }
+        return id;
+    }
+
+    // the id for a name, registering it with an empty program if it's new
+    int intern(const string& name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        const int id = size();
+        ids.emplace(name, id);
+        names.push_back(name);
+        glyphs.push_back(name.empty() ? '\0' : name[0]);
+        programs.emplace_back();
+        compiled.emplace_back();
+        limits.push_back(0);
+        uses.push_back(0);
+        return id;
+    }
+
+    // the id for a name or -1 if it's never been seen
+    int find(const string& name) const {
+        auto it = ids.find(name);
+        return it == ids.end() ? -1 : it->second;
+    }
+
+    int size() const {
+        return static_cast<int>(names.size());
+    }
+    const string& name(int id) const {
+        return names[id];
+    }
+    // what gets drawn on the board for this species
+    char glyph(int id) const {
+        return glyphs[id];
+    }
+    const Species& get(int id) const {
+        return programs[id];
+    }
+    // the program the interpreter actually runs
+    const Bytecode& code(int id) const {
+        return compiled[id];
+    }
+    // the most non actions a turn can go through, from Species::analyze
+    int limit(int id) const {
+        return limits[id];
+    }
+    // which instructions the program has in it, bit 1 << Instruction::Type each
+    uint32_t used(int id) const {
+        return uses[id];
+    }
+
+private:
+    unordered_map<string, int> ids;
+    vector<string> names;
+    vector<char> glyphs;
+    vector<Species> programs;
+    vector<Bytecode> compiled;
+    vector<int> limits;
+    vector<uint32_t> uses;
+};
+
+// builds a snapshot out of fixed width fields one after another, in host
+// byte order so the arrays can go in and come back out with a memcpy
+class SnapshotWriter {
+public:
+
+    template <typename T>
+    void put(const T& value) {
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void put_array(const vector<T>& values) {
+        bytes.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void put_string(string_view text) {
+        put(static_cast<uint32_t>(text.size()));
+        bytes.append(text);
+    }
+
+    const string& data() const {
+        return bytes;
+    }
+
+private:
+    string bytes;
+};
+
+// reads the fields back out, usually straight out of a mapped file. throws
+// invalid_argument naming the source if it runs off the end
+class SnapshotReader {
+public:
+
+    SnapshotReader(string_view bytes, const string& source) : bytes(bytes), source(source) {}
+
+    template <typename T>
+    T get() {
+        T value;
+        memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void get_array(vector<T>& values, size_t n) {
+        if (n > (bytes.size() - at) / sizeof(T)) {
+            fail("snapshot is cut short");
+        }
+        values.resize(n);
+        memcpy(values.data(), take(n * sizeof(T)), n * sizeof(T));
+    }
+
+    string_view get_string() {
+        const uint32_t n = get<uint32_t>();
+        return string_view(take(n), n);
+    }
+
+    bool done() const {
+        return at == bytes.size();
+    }
+
+    [[noreturn]] void fail(const string& what) const {
+        throw invalid_argument(source + ": " + what);
+    }
+
+private:
+    string_view bytes;
+    size_t at = 0;
+    const string& source;
+
+    const char* take(size_t n) {
+        if (n > bytes.size() - at) {
+            fail("snapshot is cut short");
+        }
+        const char* p = bytes.data() + at;
+        at += n;
+        return p;
+    }
+};
+
+// the world's own random numbers. COMPATIBLE is a copy of glibc's rand()
+// (the additive feedback generator behind random()) so a board gets exactly
+// the sequence srand(0) and rand() used to give it. FAST is xoshiro256**
+// handing out coin flips 64 at a time from one draw. KEYED works out each
+// creature's flips from the seed, the turn and the creature's id alone, so
+// they come out the same whatever order creatures run in, which is what lets
+// boards with IF_RANDOM on them run on several threads. none of them shares
+// any state between boards
+class Random {
+public:
+
+    enum Mode { COMPATIBLE, FAST, KEYED };
+
+    explicit Random(uint64_t s = 0, Mode m = COMPATIBLE) {
+        seed(s, m);
+    }
+
+    // same as srand(s) in COMPATIBLE mode
+    void seed(uint64_t s, Mode m = COMPATIBLE) {
+        mode = m;
+        flips = 0;
+        bits = 0;
+        bits_left = 0;
+        if (mode != COMPATIBLE) {
+            // splitmix64 spreads the seed over the whole state, KEYED only
+            // uses the first word
+            for (uint64_t& word : xoshiro) {
+                s += 0x9e3779b97f4a7c15ULL;
+                uint64_t z = s;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                word = z ^ (z >> 31);
+            }
+            return;
+        }
+
+        int32_t word = static_cast<uint32_t>(s) == 0 ? 1 : static_cast<int32_t>(s);
+        state[0] = word;
+        for (int i = 1; i < 31; i++) {
+            // 16807 * word % (2^31 - 1) without overflowing
+            const int32_t hi = word / 127773;
+            const int32_t lo = word % 127773;
+            word = 16807 * lo - 2836 * hi;
+            if (word < 0) {
+                word += 2147483647;
+            }
+            state[i] = word;
+        }
+        front = 3;
+        rear = 0;
+        for (int i = 0; i < 310; i++) {
+            next();
+        }
+    }
+
+    Mode get_mode() const {
+        return mode;
+    }
+
+    // how many coins have been flipped since the last seed, two boards that
+    // flipped a different number of times aren't in the same state
+    uint64_t get_flips() const {
+        return flips;
+    }
+
+    // KEYED: the flips from here on are creature id's on this turn, the
+    // other modes carry on with the one stream
+    void key(uint64_t turn, uint64_t id) {
+        if (mode == KEYED) {
+            block = mix64(xoshiro[0] ^ mix64((turn << 32) ^ id));
+            bits_left = 0;
+        }
+    }
+
+    // flips made on a copy that should count as made here
+    void add_flips(uint64_t n) {
+        flips += n;
+    }
+
+    // 0 to 2^31 - 1, the same as rand() in COMPATIBLE mode
+    int next() {
+        if (mode != COMPATIBLE) {
+            return static_cast<int>(next64() >> 33);
+        }
+        state[front] += state[rear];
+        const int result = static_cast<int>(state[front] >> 1);
+        front = front == 30 ? 0 : front + 1;
+        rear = rear == 30 ? 0 : rear + 1;
+        return result;
+    }
+
+    // what IF_RANDOM asks for, rand() % 2 in COMPATIBLE mode
+    bool coin() {
+        flips++;
+        if (mode == COMPATIBLE) {
+            return next() % 2;
+        }
+        if (bits_left == 0) {
+            bits = next64();
+            bits_left = 64;
+        }
+        const bool heads = bits & 1;
+        bits >>= 1;
+        bits_left--;
+        return heads;
+    }
+
+    // the whole generator, for a world snapshot
+    void save(SnapshotWriter& out) const {
+        out.put(static_cast<uint32_t>(mode));
+        out.put(flips);
+        for (uint32_t word : state) {
+            out.put(word);
+        }
+        out.put(static_cast<int32_t>(front));
+        out.put(static_cast<int32_t>(rear));
+        for (uint64_t word : xoshiro) {
+            out.put(word);
+        }
+        // KEYED drops its leftover flips at the next key() anyway
+        out.put(mode == KEYED ? uint64_t(0) : bits);
+        out.put(static_cast<int32_t>(mode == KEYED ? 0 : bits_left));
+    }
+
+    void load(SnapshotReader& in) {
+        const uint32_t m = in.get<uint32_t>();
+        if (m > KEYED) {
+            in.fail("unknown random mode " + to_string(m));
+        }
+        mode = static_cast<Mode>(m);
+        flips = in.get<uint64_t>();
+        for (uint32_t& word : state) {
+            word = in.get<uint32_t>();
+        }
+        front = in.get<int32_t>();
+        rear = in.get<int32_t>();
+        for (uint64_t& word : xoshiro) {
+            word = in.get<uint64_t>();
+        }
+        bits = in.get<uint64_t>();
+        bits_left = in.get<int32_t>();
+        if (front < 0 || front > 30 || rear < 0 || rear > 30 || bits_left < 0 || bits_left > 64) {
+            in.fail("bad random state");
+        }
+    }
+
+    // one xoshiro256** draw, or the next 64 bits of the key in KEYED
+    uint64_t next64() {
+        if (mode == KEYED) {
+            block += 0x9e3779b97f4a7c15ULL;
+            return mix64(block);
+        }
+        const uint64_t result = rotl(xoshiro[1] * 5, 7) * 9;
+        const uint64_t t = xoshiro[1] << 17;
+        xoshiro[2] ^= xoshiro[0];
+        xoshiro[3] ^= xoshiro[1];
+        xoshiro[1] ^= xoshiro[2];
+        xoshiro[0] ^= xoshiro[3];
+        xoshiro[2] ^= t;
+        xoshiro[3] = rotl(xoshiro[3], 45);
+        return result;
+    }
+
+private:
+    Mode mode;
+    uint64_t flips;
+
+    // COMPATIBLE
+    uint32_t state[31];
+    int front, rear;
+
+    // FAST, plus the flips left over from the last draw
+    uint64_t xoshiro[4];
+    uint64_t bits;
+    int bits_left;
+
+    // KEYED, where the current creature's flips are coming from
+    uint64_t block = 0;
+
+    // splitmix64's finalizer
+    static uint64_t mix64(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+// draws frames into one buffer that's laid out once up front: the column
+// header and the row numbers never change, so a print only fills in the cells
+// and the turn line and then goes out in a single write
+class FrameRenderer {
+public:
+
+    FrameRenderer(int r, int c) : rows(r), cols(c) {
+        // room for the turn line ahead of the body, it gets right aligned
+        // against the header so the frame is one contiguous run
+        buffer.assign(HEAD + (rows + 1) * static_cast<size_t>(cols + 3) + 1, '\n');
+        char* p = buffer.data() + HEAD;
+        *p++ = ' ';
+        *p++ = ' ';
+        for (int j = 0; j < cols; j++) {
+            *p++ = static_cast<char>('0' + j % 10);
+        }
+        *p++ = '\n';
+        for (int i = 0; i < rows; i++) {
+            *p++ = static_cast<char>('0' + i % 10);
+            *p++ = ' ';
+            p += cols;
+            *p++ = '\n';
+        }
+        // the last byte stays a newline for the blank line between frames
+    }
+
+    // where the cells of row i go
+    char* row(int i) {
+        return buffer.data() + HEAD + (i + 1) * static_cast<size_t>(cols + 3) + 2;
+    }
+
+    // puts the turn line on and hands back the finished frame
+    string_view finish(int turn, bool blank_line) {
+        char line[HEAD];
+        const int n = snprintf(line, sizeof(line), "Turn = %d.\n", turn);
+        memcpy(buffer.data() + HEAD - n, line, n);
+        const size_t body = (rows + 1) * static_cast<size_t>(cols + 3) + (blank_line ? 1 : 0);
+        return string_view(buffer.data() + HEAD - n, n + body);
+    }
+
+    // the header and cells without the turn line, for keeping a frame around
+    string_view body() const {
+        return string_view(buffer.data() + HEAD, (rows + 1) * static_cast<size_t>(cols + 3));
+    }
+
+    // puts back a body() from earlier
+    void load_body(string_view saved) {
+        memcpy(buffer.data() + HEAD, saved.data(), saved.size());
+    }
+
+private:
+    static constexpr int HEAD = 32;
+    int rows, cols;
+    vector<char> buffer;
+};
+
+// every creature on a board, kept as one dense array per field instead of one
+// heap object per creature so the turn sweep streams through memory
+class CreatureStore {
+public:
+
+    // the direction codes, turning is just adding one or three mod 4
+    enum Direction : uint8_t { NORTH, EAST, SOUTH, WEST };
+
+    // adds a creature and returns its id
+    int add(uint16_t species_id, uint8_t dir, int cell_index) {
+        species.push_back(species_id);
+        direction.push_back(dir);
+        pc.push_back(0);
+        cell.push_back(cell_index);
+        return static_cast<int>(species.size()) - 1;
+    }
+
+    // reuses an id for a new creature dropped on top of an old one
+    void reset(int id, uint16_t species_id, uint8_t dir) {
+        species[id] = species_id;
+        direction[id] = dir;
+        pc[id] = 0;
+    }
+
+    int size() const {
+        return static_cast<int>(species.size());
+    }
+
+    // 'n', 'e', 's', 'w' <-> direction codes, only used at the edges
+    static uint8_t to_code(char dir) {
+        switch (dir) {
+        case 'e':
+            return EAST;
+        case 's':
+            return SOUTH;
+        case 'w':
+            return WEST;
+        default:
+            return NORTH;
+        }
+    }
+    static char to_char(uint8_t code) {
+        return "nesw"[code & 3];
+    }
+
+    // a quarter turn either way, the & 3 wraps WEST round to NORTH and back
+    static constexpr uint8_t left_of(uint8_t dir) {
+        return (dir + 3) & 3;
+    }
+    static constexpr uint8_t right_of(uint8_t dir) {
+        return (dir + 1) & 3;
+    }
+
+    vector<uint16_t> species;   // index into the world's species table
+    vector<uint8_t> direction;  // one of the direction codes
+    vector<uint16_t> pc;        // program counter
+    vector<int> cell;           // where it is in the padded grid
+};
+
+// an individual creature of some sort of Species, this is only a handle into
+// the world's CreatureStore so it stays valid as the creature moves around
+class Creature {
+public:
+
+    // points at creature number i in the world
+    Creature(Darwin* w, int i) : world(w), id(i) {}
+
+    // runs its program until it takes an action, the turn number is only
+    // kept for the old signature, simulate makes sure nobody goes twice
+    bool execute_turn(Darwin& world, int row, int col, int current_turn);
+
+    // gets the information for the species type and direction
+    const string& get_species_type() const;
+    int get_species_id() const;
+    char get_direction() const;
+
+    // to change the species upon infection. a name the world doesn't know
+    // yet gets new_species as its program, with no program it's an error
+    void set_species(const std::string& new_species_name, const Species* new_species);
+    void set_species(int species_id);
+
+    int get_id() const {
+        return id;
+    }
+
+private:
+    Darwin* world;
+    int id;
+};
+
+// the main program for Darwin
+class Darwin {
+public:
+
+    // the grid holds creature ids, these are the two things that aren't
+    static constexpr int EMPTY = -1;
+    static constexpr int WALL = -2;
+
+    // how the bytecode interpreter picks the next op, SPECIALIZED runs the
+    // built in species through code generated for their programs and
+    // everything else THREADED
+    enum Dispatch { SWITCH, THREADED, SPECIALIZED };
+
+    // how frames are printed, DELTA writes the first one of a run in full and
+    // after that only the cells that changed, decode_frames() turns it back
+    enum Format { TEXT, DELTA };
+
+    // how a turn goes. SWEEP runs the creatures one after another, each
+    // seeing what the ones before it did. SYNCHRONOUS has every creature
+    // decide from the board as the turn started and then puts the moves in,
+    // the first creature in row-major order wins when two want the same
+    // empty cell or infect each other
+    enum Update { SWEEP, SYNCHRONOUS };
+
+    // to initialize the board "pseudo-randomly"
+    Darwin(int r, int c)
+        : rows(r), cols(c), grid(r, c, EMPTY, WALL), codes(r, c, 0, kernels::WALL_CODE),
+          occupied(static_cast<int>(grid.data().size())), renderer(r, c) {
+        offsets[CreatureStore::NORTH] = -grid.get_stride();
+        offsets[CreatureStore::EAST] = 1;
+        offsets[CreatureStore::SOUTH] = grid.get_stride();
+        offsets[CreatureStore::WEST] = -1;
+    }
+
+    // the handles hold a pointer back to us
+    Darwin(const Darwin&) = delete;
+    Darwin& operator=(const Darwin&) = delete;
+
+    // add species to the Darwin that is able to pop up or not
+    void add_species(const string& name, const Species& sp) {
+        const int id = species.define(name, sp);
+        specialized.resize(species.size());
+        specialized[id] = specialize(sp);
+    }
+
+    // add a creature to the board, and given a default orientation
+    void add_creature(const string& species_name, int row, int col, char dir) {
+        if (is_valid_position(row, col)) {
+            const int k = grid.index(row, col);
+            const uint16_t sp = static_cast<uint16_t>(species.intern(species_name));
+            const uint8_t d = CreatureStore::to_code(dir);
+            population.resize(species.size(), 0);
+            population[sp]++;
+            if (grid[k] >= 0) {
+                population[creatures.species[grid[k]]]--;
+                creatures.reset(grid[k], sp, d);
+            } else {
+                grid[k] = creatures.add(sp, d, k);
+                handles.emplace_back(this, grid[k]);
+                occupied.insert(k);
+            }
+            codes[k] = code(sp);
+        }
+    }
+
+    // runs the basis of the simulation for the board given how many turns
+    // and how frequently it wants to be printed
+    void simulate(int turns, int freq, int numOfTests, int totalNumOfTests) {
+        print_header();
+        shown.clear();
+        print_grid(0, false, false);
+        run_turns(1, turns, freq, numOfTests, totalNumOfTests);
+    }
+
+    // simulate() picking up after get_turn(), say from a checkpoint. the
+    // header goes out again so the case can be told apart from the one
+    // before it, but the frame for the turn it's on already went out
+    void resume(int turns, int freq, int numOfTests, int totalNumOfTests) {
+        print_header();
+        shown.clear();
+        run_turns(turn_number + 1, turns, freq, numOfTests, totalNumOfTests);
+    }
+
+    // the whole state of the world: the board size, the species programs,
+    // every creature, the turn and the random numbers
+    string snapshot() const;
+
+    // puts the world back the way snapshot() found it, the board has to be
+    // the same size. throws invalid_argument naming the source if data isn't
+    // a snapshot of this version or doesn't make sense
+    void restore(string_view data, const string& source = "snapshot");
+
+    // snapshot() in a single write, to path.tmp first and then renamed over
+    // path so a crash never leaves half of one behind
+    void save(const string& path) const;
+
+    // restore() from a file, mapped where that's possible
+    void load(const string& path);
+
+    // while simulating, saves to path after every `every` turns, 0 stops it
+    void set_checkpoint(const string& path, int every) {
+        checkpoint_path = path;
+        checkpoint_every = every;
+    }
+
+    // runs a single turn. the order creatures go in is fixed before anyone
+    // moves: the occupied cells in row-major order. nobody can move before
+    // their own go, so that's exactly the order a cell by cell sweep would
+    // reach them in, and since each creature is on the list once nobody
+    // that hops east or south gets a second go
+    void step() {
+        schedule.clear();
+        for (int k = occupied.next(0); k >= 0; k = occupied.next(k + 1)) {
+            schedule.push_back(grid[k]);
+        }
+        if (update == SYNCHRONOUS) {
+            step_synchronous();
+            return;
+        }
+        if (pool && can_band()) {
+            step_banded();
+            return;
+        }
+        for (int id : schedule) {
+            execute(id);
+        }
+        turn_number++;
+    }
+
+    // splits the rows into n bands that step() runs on n threads, the board
+    // comes out exactly the way the one thread sweep leaves it. turns with
+    // IF_RANDOM on the board stay on one thread unless the Random is KEYED,
+    // the other modes hand out flips in sweep order
+    void set_threads(int n) {
+        pool = n > 1 ? make_unique<WorkerPool>(n) : nullptr;
+    }
+
+    // how many turns have been run
+    int get_turn() const {
+        return turn_number;
+    }
+
+    // true once nothing on the board can move or change species again: no
+    // HOP in any species still around, no INFECT unless there's only one
+    // species left, and no IF_RANDOM. from then on every creature just turns
+    // on the spot, each on its own little loop, and simulate jumps straight
+    // to the end
+    bool is_frozen() const {
+        int present = 0;
+        const uint32_t used = used_on_board(present);
+        return !(used & (1u << Instruction::HOP)) && !(used & (1u << Instruction::IF_RANDOM)) &&
+               (!(used & (1u << Instruction::INFECT)) || present <= 1);
+    }
+
+    // every instruction used by a species with creatures on the board, and
+    // how many such species there are
+    uint32_t used_on_board(int& present) const {
+        uint32_t used = 0;
+        present = 0;
+        for (int sp = 0; sp < static_cast<int>(population.size()); sp++) {
+            if (population[sp] > 0) {
+                used |= species.used(sp);
+                present++;
+            }
+        }
+        return used;
+    }
+
+    // how many creatures of a species are on the board
+    int get_population(int species_id) const {
+        return species_id < static_cast<int>(population.size()) ? population[species_id] : 0;
+    }
+
+    // on by default, the output is the same either way
+    void set_fast_forward(bool on) {
+        fast_forward = on;
+    }
+
+    // a Zobrist style hash of everything that decides what happens next:
+    // every creature's cell, species, direction and pc, and how many coins
+    // the board has flipped. simulate keeps it up to date as creatures act
+    uint64_t get_hash() const {
+        return hash ^ mix(random.get_flips() ^ 0x5bd1e9955bd1e995ULL);
+    }
+
+    // works the hash out from scratch
+    void rehash() {
+        hash = 0;
+        for (int k = occupied.next(0); k >= 0; k = occupied.next(k + 1)) {
+            hash ^= key(grid[k]);
+        }
+    }
+
+    // on by default, once the board comes back round to a state it's been in
+    // before, the frames for the rest of the run come from a cache. the
+    // output is the same either way
+    void set_cycle_detection(bool on) {
+        cycle_detection = on;
+    }
+
+    // how long the cycle the last simulate fell into was, 0 if it didn't
+    int get_cycle_period() const {
+        return cycle.found;
+    }
+
+    // the most memory the cached frames of one cycle can take
+    void set_cycle_cache_limit(size_t bytes) {
+        cycle_cache_limit = bytes;
+    }
+
+    // checks if the propsed row and column exists on the board
+    bool is_valid_position(int row, int col) const {
+        return row >= 0 && row < rows && col >= 0 && col < cols;
+    }
+
+    // gets a local lil critter. const like it always was, the handles are
+    // only views of the store
+    Creature* get_creature(int row, int col) const {
+        if (is_valid_position(row, col) && grid[grid.index(row, col)] >= 0) {
+            return &handles[grid[grid.index(row, col)]];
+        }
+        return nullptr;
+    }
+
+    // moves the creature from one space to another if the position is valid
+    void move_creature(int from_row, int from_col, int to_row, int to_col) {
+        if (is_valid_position(from_row, from_col) && is_valid_position(to_row, to_col)) {
+            move_creature(grid.index(from_row, from_col), grid.index(to_row, to_col));
+        }
+    }
+
+    // the padded grid index versions used on the hot path, the border means
+    // there's nothing to bounds check as long as we only ever step one cell
+    int cell_index(int row, int col) const {
+        return grid.index(row, col);
+    }
+    int get_stride() const {
+        return grid.get_stride();
+    }
+    int cell(int index) const {
+        return grid[index];
+    }
+    bool is_wall(int index) const {
+        return grid[index] == WALL;
+    }
+    void move_creature(int from, int to) {
+        const int id = grid[from];
+        grid[to] = id;
+        grid[from] = EMPTY;
+        codes[to] = codes[from];
+        codes[from] = 0;
+        occupied.erase(from);
+        if (id >= 0) {
+            creatures.cell[id] = to;
+            occupied.insert(to);
+        } else {
+            occupied.erase(to);
+        }
+    }
+
+    // the raw creature fields, read only
+    const CreatureStore& get_creatures() const {
+        return creatures;
+    }
+
+    // the names and programs behind the species ids
+    const SpeciesRegistry& get_species() const {
+        return species;
+    }
+
+    // reseeds the board's random numbers, a new board starts out as if it
+    // had called srand(0)
+    void seed_random(uint64_t seed, Random::Mode mode = Random::COMPATIBLE) {
+        random.seed(seed, mode);
+    }
+
+    // where the frames go, cout unless told otherwise
+    void set_output(ostream& os) {
+        out = &os;
+    }
+
+    // what the run has done so far, all zeros unless built with DARWIN_STATS
+    Stats get_stats() const {
+        Stats counted = stats;
+        for (int sp = 0; sp < species.size(); sp++) {
+            counted.species.push_back(species.name(sp));
+        }
+        return counted;
+    }
+
+    // TEXT unless told otherwise
+    void set_format(Format f) {
+        format = f;
+    }
+
+    // SWEEP unless told otherwise, it's what the original rules say
+    void set_update(Update u) {
+        update = u;
+    }
+
+    // SPECIALIZED is the default, with computed goto behind it wherever the
+    // compiler has it
+    void set_dispatch(Dispatch d) {
+        dispatch = d;
+    }
+
+private:
+    friend class Creature;
+
+    // prints the grid
+    int rows, cols;
+    Grid<int> grid;
+    Grid<uint8_t> codes;    // the board again, a byte per cell for the kernels
+    vector<uint8_t> sensed; // SYNCHRONOUS: kernels::Sense by direction and cell, for the turn being decided
+    CellSet occupied;
+    int offsets[4];
+    CreatureStore creatures;
+    mutable deque<Creature> handles;  // a deque so adding one never moves the others
+    SpeciesRegistry species;
+    FrameRenderer renderer;
+    Random random;
+    vector<int> schedule;
+    int turn_number = 0;
+    vector<int> population;
+    bool fast_forward = true;
+    string checkpoint_path;
+    int checkpoint_every = 0;
+    vector<int> seen_at;
+
+    // everything cycle detection needs, the hash of every turn so far and,
+    // once a turn's hash matches an earlier one, the lap being checked
+    struct Cycle {
+        unordered_map<uint64_t, int> first_seen;  // hash -> turn
+        vector<uint64_t> hashes;                  // by turn, since hashing last started
+        int start = 0;                            // the turn that matched an earlier one
+        int period = 0;                           // 0 while there's no lap going
+        vector<string> frames;                    // by phase, empty if it isn't needed
+        vector<int> needed;                       // phases printed after the lap
+        vector<Stats> counted;                    // the counters on each turn of the lap
+        int final_phase = 0;
+        int found = 0;                            // the period once the lap checks out
+
+        // the board as it'll be on the last turn
+        CreatureStore creatures;
+        vector<int> cells;
+        CellSet occupied;
+        vector<int> population;
+
+        void clear() {
+            first_seen.clear();
+            hashes.clear();
+            period = 0;
+            found = 0;
+            frames.clear();
+        }
+    };
+    Cycle cycle;
+    bool cycle_detection = true;
+    bool hashing = false;
+    size_t cycle_cache_limit = size_t(256) << 20;
+    uint64_t hash = 0;
+
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    // what one creature adds to the hash
+    uint64_t key(int id) const {
+        return mix(static_cast<uint64_t>(creatures.cell[id]) << 32 | static_cast<uint64_t>(creatures.species[id]) << 16 |
+                   static_cast<uint64_t>(creatures.pc[id]) << 2 | creatures.direction[id]);
+    }
+
+    bool follow_cycle(int turn, int turns, int freq, bool lastTestCase);
+
+    // a board that flips coins won't come back to the same state, so the
+    // hash is only kept while nothing on the board has an IF_RANDOM
+    void watch_for_cycles() {
+        int present;
+        const bool worth_it = cycle_detection && !(used_on_board(present) & (1u << Instruction::IF_RANDOM));
+        if (worth_it && !hashing) {
+            rehash();
+            cycle.clear();
+        } else if (!worth_it && hashing) {
+            cycle.clear();
+        }
+        hashing = worth_it;
+    }
+    ostream* out = &cout;
+    Stats stats;
+    Format format = TEXT;
+    string shown;   // DELTA: the body of the last frame printed, empty before the first
+    string delta;
+    Dispatch dispatch = SPECIALIZED;
+    Update update = SWEEP;
+
+    // SYNCHRONOUS: what a creature decided to do to the board this turn,
+    // left for after everyone has decided
+    struct Intent {
+        enum Op : uint8_t { NONE, HOP, INFECT };
+        Op op = NONE;
+        uint16_t species = 0;   // INFECT: the infector's species when it decided
+        int target = 0;         // HOP: the cell, INFECT: the creature
+    };
+    vector<Intent> intents;
+    // SYNCHRONOUS fills in the sensed table when at least one cell in this
+    // many is taken, on emptier boards looking one creature at a time wins
+    static constexpr int SENSE_DENSITY = 8;
+    vector<char> infected;      // by creature id, infected earlier in the turn being put in
+
+    // what running a creature writes besides the board and the creature
+    // arrays. the sequential sweep points it at the world's own totals, each
+    // band of the parallel sweep has its own that get added up after the turn
+    struct Lane {
+        int* population;
+        uint64_t* hash;
+        Stats* stats;
+        Random* random;
+        vector<pair<int, int>>* moves;  // hops still to go into occupied, null puts them in right away
+        Intent* intent = nullptr;       // when set, hops and infections land here instead of on the board
+        const uint8_t* sensed = nullptr; // when set, what's ahead comes out of this table
+    };
+
+    Lane own_lane() {
+        return {population.data(), &hash, &stats, &random, nullptr};
+    }
+
+    // what's in front of creature id, looking at cell ahead. it can't change
+    // before the creature's action, so the interpreters look once per turn
+    int sense(int id, int ahead, const Lane& lane) const {
+        if (lane.sensed) {
+            return lane.sensed[creatures.direction[id] * grid.data().size() + creatures.cell[id]];
+        }
+        const int there = grid[ahead];
+        if (there < 0) {
+            return there == EMPTY ? kernels::EMPTY : kernels::WALL;
+        }
+        return creatures.species[there] == creatures.species[id] ? kernels::FRIEND : kernels::ENEMY;
+    }
+
+    // a creature of species sp in codes, past kernels::MAX_SPECIES species
+    // the codes stop meaning anything and byte_board() says so
+    static uint8_t code(int sp) {
+        return static_cast<uint8_t>(sp + 1);
+    }
+    bool byte_board() const {
+        return species.size() <= kernels::MAX_SPECIES;
+    }
+
+    // codes worked out again from grid
+    void recode() {
+        vector<uint8_t>& bytes = codes.data();
+        for (size_t k = 0; k < bytes.size(); k++) {
+            const int id = grid.data()[k];
+            bytes[k] = id == WALL ? kernels::WALL_CODE : id == EMPTY ? 0 : code(creatures.species[id]);
+        }
+    }
+
+    // fills sensed for rows [lo, hi) in all four directions
+    void sense_rows(int lo, int hi) {
+        const size_t size = codes.data().size();
+        for (int i = lo; i < hi; i++) {
+            const int k = codes.index(i, 0);
+            for (int d = 0; d < 4; d++) {
+                kernels::sense_row(&codes[k], &codes[k + offsets[d]], cols, &sensed[d * size + k]);
+            }
+        }
+    }
+
+    // per species id, the interpreter generated for its program when it's
+    // one of the built ins, null for everything else
+    using Runner = void (Darwin::*)(int, Lane&);
+    vector<Runner> specialized;
+    static Runner specialize(const Species& sp);
+
+    // the parallel step(), see step_banded()
+    struct Band {
+        vector<int> population;         // changes, added to the world's after the turn
+        uint64_t hash = 0;
+        Stats stats;
+        Random random;
+        vector<pair<int, int>> moves;
+        vector<int> deferred;           // left for after the bands, in sweep order
+    };
+    unique_ptr<WorkerPool> pool;
+    vector<Band> bands;
+    vector<int> split;                  // each band's first place on the schedule
+    vector<int> claimed;                // cells a deferred creature touches, marked with claim_stamp
+    int claim_stamp = 0;
+
+    bool can_band() const {
+        return rows >= 2 * pool->size() && can_split();
+    }
+
+    // the coin flips come out the same whatever order the creatures go in
+    bool can_split() const {
+        int present = 0;
+        return random.get_mode() == Random::KEYED || !(used_on_board(present) & (1u << Instruction::IF_RANDOM));
+    }
+
+    void step_banded();
+    void step_synchronous();
+
+    // the turns of simulate() and resume(), from turn first on
+    void run_turns(int first, int turns, int freq, int numOfTests, int totalNumOfTests) {
+        // cout << "turns: " << turns << "\t frequency: " << freq << "\n";
+        int totalPrints = turns/freq;
+        int printing = (first - 1) / freq + 1;
+
+        cycle.clear();
+
+        for (int turn = first; turn <= turns; turn++) {
+            bool toPrintEndline1 = (totalNumOfTests == (numOfTests+1));
+            if (fast_forward && is_frozen()) {
+                skip_frozen(turn, turns, freq, toPrintEndline1);
+                // nobody changes species on a frozen board
+                DARWIN_COUNT(record_population(turns - turn + 1));
+                break;
+            }
+            watch_for_cycles();
+            step();
+            DARWIN_COUNT(record_population());
+
+            // cout << "total prints: " << totalPrints << "\t printing int: " << printing << "\n";
+            bool toPrintEndline2 = (printing == (totalPrints));
+            // cout << "total prints equals the currenting printing tracker? " << toPrintEndline2 << "\n";
+            // cout << "testcases match? " << toPrintEndline1 << "\t last turn of simulation printing? " << toPrintEndline2 << "\n";
+            if (turn % freq == 0) {
+                // cout<< "total test cases: " << totalNumOfTests << "\t current testcase: " << numOfTests << "\n";
+                print_grid(turn, toPrintEndline1, toPrintEndline2);
+                printing++;
+            }
+            if (checkpoint_every > 0 && turn % checkpoint_every == 0) {
+                save(checkpoint_path);
+            }
+            if (hashing && follow_cycle(turn, turns, freq, toPrintEndline1)) {
+                DARWIN_COUNT(repeat_population(turn, turns, cycle.found));
+                break;
+            }
+        }
+        hashing = false;
+    }
+
+    // the population after this turn, for stats, times over for the turns
+    // a frozen board skips
+    void record_population(int times = 1) {
+        if (stats.population.empty()) {
+            stats.first_turn = turn_number - (times - 1);
+        }
+        vector<int> counts = population;
+        counts.resize(species.size(), 0);
+        stats.population.insert(stats.population.end(), times, counts);
+    }
+
+    // the turns after a cycle went the way they did a period back
+    void repeat_population(int turn, int turns, int period) {
+        for (int t = turn + 1; t <= turns; t++) {
+            stats.population.push_back(stats.population[t - period - stats.first_turn]);
+        }
+    }
+
+    void execute(int id) {
+        Lane lane = own_lane();
+        execute(id, lane);
+    }
+    void execute(int id, Lane& lane);
+    void skip_frozen(int first, int turns, int freq, bool lastTestCase);
+    void advance_frozen(int id, int n);
+
+    // infection, keeps the population counts and hash right
+    void change_species(int id, int sp) {
+        Lane lane = own_lane();
+        change_species(id, sp, lane);
+    }
+    void change_species(int id, int sp, Lane& lane) {
+        if (lane.intent) {
+            *lane.intent = {Intent::INFECT, static_cast<uint16_t>(sp), id};
+            return;
+        }
+        if (hashing) {
+            *lane.hash ^= key(id);
+        }
+        lane.population[creatures.species[id]]--;
+        lane.population[sp]++;
+        creatures.species[id] = static_cast<uint16_t>(sp);
+        creatures.pc[id] = 0;
+        codes[creatures.cell[id]] = code(sp);
+        if (hashing) {
+            *lane.hash ^= key(id);
+        }
+    }
+
+    // a HOP into an empty cell
+    void hop(int from, int to, Lane& lane) {
+        if (lane.intent) {
+            *lane.intent = {Intent::HOP, 0, to};
+            return;
+        }
+        const int id = grid[from];
+        grid[to] = id;
+        grid[from] = EMPTY;
+        codes[to] = codes[from];
+        codes[from] = 0;
+        creatures.cell[id] = to;
+        if (lane.moves) {
+            lane.moves->emplace_back(from, to);
+        } else {
+            occupied.erase(from);
+            occupied.insert(to);
+        }
+    }
+
+    void run_switch(int id, Lane& lane);
+    void run_threaded(int id, Lane& lane);
+    template <const auto& P>
+    void run_static(int id, Lane& lane);
+    template <const auto& P, int PC, int DEPTH>
+    int run_static_at(int id, int here, int ahead, int look, Lane& lane);
+
+    // "*** Darwin RxC ***", what each case's output starts with
+    void print_header() {
+        *out << "*** Darwin " << rows << "x" << cols << " ***\n";
+    }
+
+    void print_grid(int turn, bool lastTestCase, bool lastTurn) {
+        draw_cells();
+        emit_frame(turn, lastTestCase, lastTurn);
+    }
+
+    // puts the board into the renderer, through the palette a row at a time
+    // while every species has a byte code
+    void draw_cells() {
+        if (byte_board()) {
+            char palette[256] = {'.'};
+            for (int sp = 0; sp < species.size(); sp++) {
+                palette[code(sp)] = species.glyph(sp);
+            }
+            for (int i = 0; i < rows; i++) {
+                kernels::glyph_row(&codes[codes.index(i, 0)], cols, palette, species.size() + 1, renderer.row(i));
+            }
+            return;
+        }
+        for (int i = 0; i < rows; i++) {
+            char* out = renderer.row(i);
+            const int begin = grid.index(i, 0);
+            for (int k = begin; k < begin + cols; k++) {
+                const int id = grid[k];
+                *out++ = id >= 0 ? species.glyph(creatures.species[id]) : '.';
+            }
+        }
+    }
+
+    // writes out whatever's in the renderer as the frame for this turn
+    void emit_frame(int turn, bool lastTestCase, bool lastTurn) {
+        // cout << "is this last testcase? " << lastTestCase << "\t is this last turn of printing? " << lastTurn << "\n";
+        const bool blank = !lastTestCase || (!lastTurn && lastTestCase);
+        if (format == DELTA && !shown.empty()) {
+            emit_delta(turn, blank);
+            return;
+        }
+        const string_view frame = renderer.finish(turn, blank);
+        out->write(frame.data(), frame.size());
+        if (format == DELTA) {
+            shown.assign(renderer.body());
+        }
+    }
+
+    // "Turn = N. changes" and then a "row col old new" line per cell that's
+    // different from the last frame, rows that didn't change cost a memcmp
+    void emit_delta(int turn, bool blank) {
+        const char* body = renderer.body().data();
+        int changes = 0;
+        delta.clear();
+        for (int i = 0; i < rows; i++) {
+            const char* now = renderer.row(i);
+            char* was = shown.data() + (now - body);
+            if (memcmp(now, was, cols) == 0) {
+                continue;
+            }
+            for (int j = 0; j < cols; j++) {
+                if (now[j] != was[j]) {
+                    char line[32];
+                    const int n = snprintf(line, sizeof(line), "%d %d %c %c\n", i, j, was[j], now[j]);
+                    delta.append(line, n);
+                    was[j] = now[j];
+                    changes++;
+                }
+            }
+        }
+        *out << "Turn = " << turn << ". " << changes << "\n";
+        out->write(delta.data(), delta.size());
+        if (blank) {
+            *out << "\n";
+        }
+    }
+};
+
+inline const string& Creature::get_species_type() const {
+    return world->species.name(world->creatures.species[id]);
+}
+
+inline int Creature::get_species_id() const {
+    return world->creatures.species[id];
+}
+
+inline char Creature::get_direction() const {
+    return CreatureStore::to_char(world->creatures.direction[id]);
+}
+
+inline void Creature::set_species(const std::string& new_species_name, const Species* new_species) {
+    if (world->species.find(new_species_name) < 0) {
+        if (!new_species) {
+            throw invalid_argument("unknown species \"" + new_species_name + "\"");
+        }
+        world->add_species(new_species_name, *new_species);
+    }
+    set_species(world->species.find(new_species_name));
+}
+
+inline void Creature::set_species(int species_id) {
+    world->population.resize(world->species.size(), 0);
+    world->change_species(id, species_id);
+}
+
+inline bool Creature::execute_turn(Darwin&, int row, int col, int) {
+    if (!world->is_valid_position(row, col) || world->cell(world->cell_index(row, col)) != id) {
+        return false;
+    }
+    world->execute(id);
+    return true;
+}
+
+// prints the rest of a frozen board's frames and leaves every creature where
+// it would have been after the last turn. the board itself never changes
+// again so it only gets drawn once, and each creature's (pc, direction) goes
+// round a loop so it only needs running until the loop shows up
+inline void Darwin::skip_frozen(int first, int turns, int freq, bool lastTestCase) {
+    const int totalPrints = turns / freq;
+    draw_cells();
+    for (int turn = (first + freq - 1) / freq * freq; turn <= turns; turn += freq) {
+        emit_frame(turn, lastTestCase, turn / freq == totalPrints);
+    }
+
+    const int n = turns - first + 1;
+    for (int k = occupied.next(0); k >= 0; k = occupied.next(k + 1)) {
+        advance_frozen(grid[k], n);
+    }
+    turn_number += n;
+}
+
+// runs a creature n turns on a frozen board, nothing it does can touch
+// anything but its own pc and direction
+inline void Darwin::advance_frozen(int id, int n) {
+    const int size = species.code(creatures.species[id]).size();
+    if (size == 0) {
+        return;
+    }
+    seen_at.assign(size * 4, -1);
+    for (int t = 0; t < n; t++) {
+        int& seen = seen_at[creatures.pc[id] * 4 + creatures.direction[id]];
+        if (seen >= 0) {
+            // been here before, so only the leftover part of the loop matters
+            const int period = t - seen;
+            int left = n - t;
+#ifdef DARWIN_STATS
+            // one more time round to count it, the rest of the laps are the same
+            if (left >= period) {
+                const Stats before = stats.counters();
+                for (int k = 0; k < period; k++) {
+                    execute(id);
+                }
+                left -= period;
+                stats.repeat(before, stats.counters(), left / period);
+            }
+#endif
+            for (left %= period; left > 0; left--) {
+                execute(id);
+            }
+            return;
+        }
+        seen = t;
+        execute(id);
+    }
+}
+
+// runs one creature's program until it takes an action
+inline void Darwin::execute(int id, Lane& lane) {
+    if (!species.code(creatures.species[id]).empty()) {
+        if (hashing) {
+            *lane.hash ^= key(id);
+        }
+        DARWIN_COUNT(lane.stats->actions++);
+        lane.random->key(turn_number, id);
+        const int sp = creatures.species[id];
+        if (dispatch == SPECIALIZED && sp < static_cast<int>(specialized.size()) && specialized[sp]) {
+            (this->*specialized[sp])(id, lane);
+        } else if (dispatch != SWITCH) {
+            run_threaded(id, lane);
+        } else {
+            run_switch(id, lane);
+        }
+        if (hashing) {
+            *lane.hash ^= key(id);
+        }
+    }
+}
+
+// a creature only ever touches its own cell and the one ahead of it, and
+// neither it nor the direction it faces can change before its go. so two
+// creatures whose pairs of cells don't meet can go in either order. each
+// band runs its creatures in sweep order, except that a creature reaching
+// into another band, or touching a cell some creature already put off
+// touches, is put off too. what's left in a band can't meet anything in
+// another band, and can't meet anything put off that comes before it in the
+// sweep. the put off ones then go one at a time in sweep order
+inline void Darwin::step_banded() {
+    const int n = pool->size();
+    const int stride = grid.get_stride();
+    bands.resize(n);
+    claimed.resize(grid.data().size(), 0);
+    const int stamp = ++claim_stamp;
+    population.resize(species.size(), 0);
+
+    // a south facing creature on the last row of a band reaches into the
+    // first row of the next band before anything there goes
+    for (int b = 1; b < n; b++) {
+        const int row = rows * b / n - 1;
+        for (int k = grid.index(row, 0); k < grid.index(row, cols); k++) {
+            if (grid[k] >= 0 && creatures.direction[grid[k]] == CreatureStore::SOUTH) {
+                claimed[k + stride] = stamp;
+            }
+        }
+    }
+
+    // where each band's creatures start on the schedule, worked out before
+    // anybody moves
+    split.assign(n + 1, static_cast<int>(schedule.size()));
+    for (int b = n - 1; b >= 0; b--) {
+        const int first = grid.index(rows * b / n, 0);
+        int i = split[b + 1];
+        while (i > 0 && creatures.cell[schedule[i - 1]] >= first) {
+            i--;
+        }
+        split[b] = i;
+    }
+
+    const function<void(int)> job = [&](int b) {
+        Band& band = bands[b];
+        band.population.assign(species.size(), 0);
+        band.hash = 0;
+        band.stats = Stats();
+        band.random = random;
+        band.moves.clear();
+        band.deferred.clear();
+        Lane lane = {band.population.data(), &band.hash, &band.stats, &band.random, &band.moves};
+
+        const int lo = rows * b / n;
+        const int hi = rows * (b + 1) / n;
+        for (int i = split[b]; i < split[b + 1]; i++) {
+            const int id = schedule[i];
+            const int k = creatures.cell[id];
+            const int ahead = k + offsets[creatures.direction[id]];
+            const int row = ahead / stride - 1;
+            const bool edge = row >= 0 && row < rows && (row < lo || row >= hi);
+            if (edge || claimed[k] == stamp || claimed[ahead] == stamp) {
+                claimed[k] = stamp;
+                if (!edge) {
+                    claimed[ahead] = stamp;
+                }
+                band.deferred.push_back(id);
+            } else {
+                execute(id, lane);
+            }
+        }
+    };
+    pool->run(job);
+
+    const uint64_t flips = random.get_flips();
+    for (Band& band : bands) {
+        for (int sp = 0; sp < static_cast<int>(band.population.size()); sp++) {
+            population[sp] += band.population[sp];
+        }
+        hash ^= band.hash;
+        DARWIN_COUNT(stats.merge(band.stats));
+        random.add_flips(band.random.get_flips() - flips);
+        // whoever's in a cell now is who ended up there
+        for (const auto& [from, to] : band.moves) {
+            if (grid[from] < 0) {
+                occupied.erase(from);
+            }
+            occupied.insert(to);
+        }
+    }
+    for (const Band& band : bands) {
+        for (int id : band.deferred) {
+            execute(id);
+        }
+    }
+    turn_number++;
+}
+
+// a turn where nobody sees anything done earlier in it. the interpreters run
+// against the untouched board with hop() and change_species() writing down
+// what they would do instead of doing it, so the deciding can be split up any
+// way at all. then the intents go in, in row-major order: a hop only ever
+// targets a cell that was empty, so the first one there gets it and the rest
+// are blocked, and a creature infected earlier in the order has lost its
+// own infection, which settles two creatures infecting each other. the
+// board doesn't change while they decide, so what each one sees comes out
+// of a table the kernels fill in a whole row at a time first
+inline void Darwin::step_synchronous() {
+    const int total = static_cast<int>(schedule.size());
+    intents.resize(creatures.size());
+    population.resize(species.size(), 0);
+    const uint8_t* table = nullptr;
+    if (byte_board() && total * SENSE_DENSITY >= rows * cols) {
+        sensed.resize(4 * codes.data().size());
+        table = sensed.data();
+    }
+
+    if (pool && can_split()) {
+        const int n = pool->size();
+        bands.resize(n);
+        if (table) {
+            pool->run([&](int b) {
+                sense_rows(rows * b / n, rows * (b + 1) / n);
+            });
+        }
+        const function<void(int)> job = [&](int b) {
+            Band& band = bands[b];
+            band.population.assign(species.size(), 0);
+            band.hash = 0;
+            band.stats = Stats();
+            band.random = random;
+            Lane lane = {band.population.data(), &band.hash, &band.stats, &band.random, nullptr};
+            lane.sensed = table;
+            for (int i = total * b / n; i < total * (b + 1) / n; i++) {
+                const int id = schedule[i];
+                intents[id] = Intent();
+                lane.intent = &intents[id];
+                execute(id, lane);
+            }
+        };
+        pool->run(job);
+        const uint64_t flips = random.get_flips();
+        for (const Band& band : bands) {
+            hash ^= band.hash;
+            DARWIN_COUNT(stats.merge(band.stats));
+            random.add_flips(band.random.get_flips() - flips);
+        }
+    } else {
+        if (table) {
+            sense_rows(0, rows);
+        }
+        Lane lane = own_lane();
+        lane.sensed = table;
+        for (int id : schedule) {
+            intents[id] = Intent();
+            lane.intent = &intents[id];
+            execute(id, lane);
+        }
+    }
+
+    Lane lane = own_lane();
+    infected.assign(creatures.size(), 0);
+    for (int id : schedule) {
+        const Intent& intent = intents[id];
+        if (intent.op == Intent::HOP) {
+            if (grid[intent.target] == EMPTY) {
+                if (hashing) {
+                    hash ^= key(id);
+                }
+                hop(creatures.cell[id], intent.target, lane);
+                if (hashing) {
+                    hash ^= key(id);
+                }
+            } else {
+                DARWIN_COUNT(stats.hops_blocked++);
+            }
+        } else if (intent.op == Intent::INFECT) {
+            if (!infected[id] && !infected[intent.target]) {
+                infected[intent.target] = 1;
+                change_species(intent.target, intent.species, lane);
+            } else {
+                DARWIN_COUNT(stats.infections--);
+            }
+        }
+    }
+    turn_number++;
+}
+
+// called after every turn of simulate. the first time a turn's hash matches
+// an earlier turn's, the board is taken to be in a cycle of that length and
+// it runs one more lap to make sure, checking each hash against the one a
+// period back and keeping the frames that will be needed later. if the lap
+// holds up the rest of the frames come out of that cache, the board is put
+// into the state it would've had on the last turn, and it returns true
+inline bool Darwin::follow_cycle(int turn, int turns, int freq, bool lastTestCase) {
+    Cycle& c = cycle;
+    const uint64_t h = get_hash();
+    c.hashes.resize(turn + 1);
+    c.hashes[turn] = h;
+
+    auto save = [&](int at) {
+        const int phase = (at - c.start) % c.period;
+        if (!c.needed.empty() && c.needed[phase]) {
+            draw_cells();
+            c.frames[phase] = string(renderer.body());
+        }
+        DARWIN_COUNT(c.counted[at - c.start] = stats.counters());
+        if (phase == c.final_phase) {
+            c.creatures = creatures;
+            c.cells = grid.data();
+            c.occupied = occupied;
+            c.population = population;
+        }
+    };
+
+    if (c.period == 0) {
+        auto [it, fresh] = c.first_seen.emplace(h, turn);
+        if (fresh) {
+            return false;
+        }
+        const int period = turn - it->second;
+        if (turn + period >= turns) {
+            return false;  // not enough run left to be worth it
+        }
+
+        // which phases still get printed after the lap
+        c.start = turn;
+        c.period = period;
+        c.needed.assign(period, 0);
+        c.frames.assign(period, string());
+        DARWIN_COUNT(c.counted.resize(period + 1));
+        size_t bytes = 0;
+        // after period prints the phases start repeating
+        for (int t = (turn + period + freq) / freq * freq, n = 0; t <= turns && n < period; t += freq, n++) {
+            int& need = c.needed[(t - turn) % period];
+            if (!need) {
+                need = 1;
+                bytes += renderer.body().size();
+            }
+        }
+        if (bytes > cycle_cache_limit) {
+            c.period = 0;
+            return false;
+        }
+        c.final_phase = (turns - turn) % period;
+        save(turn);
+        return false;
+    }
+
+    // still on the lap, everything has to match
+    if (h != c.hashes[turn - c.period]) {
+        c.period = 0;
+        c.first_seen.clear();
+        c.first_seen.emplace(h, turn);
+        return false;
+    }
+    save(turn);
+    if (turn < c.start + c.period) {
+        return false;
+    }
+
+    // it's a cycle, print the rest from the cache
+    c.found = c.period;
+    const int totalPrints = turns / freq;
+    for (int t = (turn + freq) / freq * freq; t <= turns; t += freq) {
+        renderer.load_body(c.frames[(t - c.start) % c.period]);
+        emit_frame(t, lastTestCase, t / freq == totalPrints);
+    }
+    creatures = c.creatures;
+    grid.data() = c.cells;
+    recode();
+    occupied = c.occupied;
+    population = c.population;
+    rehash();
+    // the rest of the run is whole laps and then part of one
+    DARWIN_COUNT(stats.repeat(c.counted[0], c.counted[c.period], (turns - turn) / c.period));
+    DARWIN_COUNT(stats.repeat(c.counted[0], c.counted[(turns - turn) % c.period], 1));
+    turn_number += turns - turn;
+    return true;
+}
+
+// the plain interpreter, every branch already knows its target so this is a
+// load and a switch per op
+inline void Darwin::run_switch(int id, Lane& lane) {
+    const Bytecode& code = species.code(creatures.species[id]);
+    const int here = creatures.cell[id];
+    // turning is always the last thing a creature does, so what's ahead can't change
+    const int ahead = here + offsets[creatures.direction[id]];
+    const int look = sense(id, ahead, lane);
+    int pc = creatures.pc[id];
+
+    // analyze() proved a turn never needs more tests than this
+    for (int budget = species.limit(creatures.species[id]); budget >= 0; budget--) {
+        const uint32_t w = code[pc];
+        DARWIN_COUNT(lane.stats->ops[Bytecode::op(w)]++);
+        switch (Bytecode::op(w)) {
+        case Instruction::HOP:
+            if (look == kernels::EMPTY) {
+                hop(here, ahead, lane);
+            } else {
+                DARWIN_COUNT(lane.stats->hops_blocked++);
+            }
+            break;
+
+        case Instruction::LEFT:
+            creatures.direction[id] = CreatureStore::left_of(creatures.direction[id]);
+            break;
+
+        case Instruction::RIGHT:
+            creatures.direction[id] = CreatureStore::right_of(creatures.direction[id]);
+            break;
+
+        case Instruction::INFECT:
+            if (look == kernels::ENEMY) {
+                change_species(grid[ahead], creatures.species[id], lane);
+                DARWIN_COUNT(lane.stats->infections++);
+            }
+            break;
+
+        case Instruction::IF_EMPTY:
+            pc = look == kernels::EMPTY ? Bytecode::taken(w) : Bytecode::next(w);
+            continue;
+
+        case Instruction::IF_WALL:
+            pc = look == kernels::WALL ? Bytecode::taken(w) : Bytecode::next(w);
+            continue;
+
+        case Instruction::IF_RANDOM:
+            pc = lane.random->coin() ? Bytecode::taken(w) : Bytecode::next(w);
+            continue;
+
+        case Instruction::IF_ENEMY:
+            pc = look == kernels::ENEMY ? Bytecode::taken(w) : Bytecode::next(w);
+            continue;
+
+        default: // GO
+            pc = Bytecode::taken(w);
+            continue;
+        }
+
+        // every action falls through to here
+        creatures.pc[id] = static_cast<uint16_t>(Bytecode::next(w));
+        return;
+    }
+    // out of budget, which only a program analyze() turned down can do, so
+    // the creature just sits this turn out
+}
+
+// the same interpreter with computed gotos, each op jumps straight to the
+// handler of the next one instead of going back through a shared switch
+#if DARWIN_THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+inline void Darwin::run_threaded(int id, Lane& lane) {
+#if DARWIN_THREADED
+    static void* const handlers[] = {
+        &&hop, &&left, &&right, &&infect, &&if_empty, &&if_wall, &&if_random, &&if_enemy, &&go
+    };
+
+    const Bytecode& code = species.code(creatures.species[id]);
+    const int here = creatures.cell[id];
+    const int ahead = here + offsets[creatures.direction[id]];
+    const int look = sense(id, ahead, lane);
+    int pc = creatures.pc[id];
+    int budget = species.limit(creatures.species[id]);
+    uint32_t w = code[pc];
+
+    // the first op is free, every test or GO after that spends from the budget
+#define DARWIN_DISPATCH() do { if (budget-- == 0) return; w = code[pc]; DARWIN_COUNT(lane.stats->ops[Bytecode::op(w)]++); goto *handlers[Bytecode::op(w)]; } while (0)
+    DARWIN_COUNT(lane.stats->ops[Bytecode::op(w)]++);
+    goto *handlers[Bytecode::op(w)];
+
+hop:
+    if (look == kernels::EMPTY) {
+        hop(here, ahead, lane);
+    } else {
+        DARWIN_COUNT(lane.stats->hops_blocked++);
+    }
+    goto done;
+
+left:
+    creatures.direction[id] = CreatureStore::left_of(creatures.direction[id]);
+    goto done;
+
+right:
+    creatures.direction[id] = CreatureStore::right_of(creatures.direction[id]);
+    goto done;
+
+infect:
+    if (look == kernels::ENEMY) {
+        change_species(grid[ahead], creatures.species[id], lane);
+        DARWIN_COUNT(lane.stats->infections++);
+    }
+    goto done;
+
+if_empty:
+    pc = look == kernels::EMPTY ? Bytecode::taken(w) : Bytecode::next(w);
+    DARWIN_DISPATCH();
+
+if_wall:
+    pc = look == kernels::WALL ? Bytecode::taken(w) : Bytecode::next(w);
+    DARWIN_DISPATCH();
+
+if_random:
+    pc = lane.random->coin() ? Bytecode::taken(w) : Bytecode::next(w);
+    DARWIN_DISPATCH();
+
+if_enemy:
+    pc = look == kernels::ENEMY ? Bytecode::taken(w) : Bytecode::next(w);
+    DARWIN_DISPATCH();
+
+go:
+    pc = Bytecode::taken(w);
+    DARWIN_DISPATCH();
+#undef DARWIN_DISPATCH
+
+done:
+    creatures.pc[id] = static_cast<uint16_t>(Bytecode::next(w));
+#else
+    run_switch(id, lane);
+#endif
+}
+#if DARWIN_THREADED
+#pragma GCC diagnostic pop
+#endif
+
+inline Darwin::Runner Darwin::specialize(const Species& sp) {
+    const vector<Instruction>& program = sp.get_program();
+    if (builtin::same_program(program, builtin::FOOD)) {
+        return &Darwin::run_static<builtin::FOOD>;
+    }
+    if (builtin::same_program(program, builtin::HOPPER)) {
+        return &Darwin::run_static<builtin::HOPPER>;
+    }
+    if (builtin::same_program(program, builtin::ROVER)) {
+        return &Darwin::run_static<builtin::ROVER>;
+    }
+    if (builtin::same_program(program, builtin::TRAP)) {
+        return &Darwin::run_static<builtin::TRAP>;
+    }
+    return nullptr;
+}
+
+// a program known at compile time, one entry point per pc and every jump a
+// constant, so each test is a compare and a direct call the compiler inlines
+template <const auto& P>
+inline void Darwin::run_static(int id, Lane& lane) {
+    static constexpr auto entries = []<size_t... I>(index_sequence<I...>) {
+        return array<int (Darwin::*)(int, int, int, int, Lane&), sizeof...(I)> {&Darwin::run_static_at<P, int(I), 0>...};
+    }(make_index_sequence<P.size()>());
+
+    const int here = creatures.cell[id];
+    const int ahead = here + offsets[creatures.direction[id]];
+    const int look = sense(id, ahead, lane);
+    creatures.pc[id] = static_cast<uint16_t>((this->*entries[creatures.pc[id]])(id, here, ahead, look, lane));
+}
+
+// runs the program from PC until it takes an action and returns the pc to
+// start from next turn, which is what the bytecode would have left there
+template <const auto& P, int PC, int DEPTH>
+inline int Darwin::run_static_at(int id, int here, int ahead, int look, Lane& lane) {
+    constexpr int N = static_cast<int>(P.size());
+    constexpr Instruction inst = P[PC];
+    constexpr int NEXT = builtin::landing(P, (PC + 1) % N);
+
+    if constexpr (DEPTH > N) {
+        return PC;  // only a program that can spin forever gets here
+    } else {
+        DARWIN_COUNT(lane.stats->ops[inst.type]++);
+        if constexpr (inst.type == Instruction::HOP) {
+            if (look == kernels::EMPTY) {
+                hop(here, ahead, lane);
+            } else {
+                DARWIN_COUNT(lane.stats->hops_blocked++);
+            }
+            return NEXT;
+        } else if constexpr (inst.type == Instruction::LEFT) {
+            creatures.direction[id] = CreatureStore::left_of(creatures.direction[id]);
+            return NEXT;
+        } else if constexpr (inst.type == Instruction::RIGHT) {
+            creatures.direction[id] = CreatureStore::right_of(creatures.direction[id]);
+            return NEXT;
+        } else if constexpr (inst.type == Instruction::INFECT) {
+            if (look == kernels::ENEMY) {
+                change_species(grid[ahead], creatures.species[id], lane);
+                DARWIN_COUNT(lane.stats->infections++);
+            }
+            return NEXT;
+        } else if constexpr (inst.type == Instruction::GO) {
+            return run_static_at<P, builtin::landing(P, inst.param), DEPTH + 1>(id, here, ahead, look, lane);
+        } else {
+            constexpr int TAKEN = builtin::landing(P, inst.param);
+            bool test;
+            if constexpr (inst.type == Instruction::IF_EMPTY) {
+                test = look == kernels::EMPTY;
+            } else if constexpr (inst.type == Instruction::IF_WALL) {
+                test = look == kernels::WALL;
+            } else if constexpr (inst.type == Instruction::IF_RANDOM) {
+                test = lane.random->coin();
+            } else {
+                test = look == kernels::ENEMY;
+            }
+            return test ? run_static_at<P, TAKEN, DEPTH + 1>(id, here, ahead, look, lane) :
+                   run_static_at<P, NEXT, DEPTH + 1>(id, here, ahead, look, lane);
+        }
+    }
+}
+
+// the whole input held in memory, mapped straight from the file when it's a
+// real file and read in one go when it's a pipe
+class InputBuffer {
+public:
+
+    // maps a file by name, throws invalid_argument if it can't be read
+    static InputBuffer open(const string& path) {
+        InputBuffer input;
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) {
+            throw invalid_argument(path + ": can't open input");
+        }
+        input.load(file);
+        fclose(file);
+        return input;
+    }
+
+    // everything on an already open stream, stdin by default
+    static InputBuffer read(FILE* file = stdin) {
+        InputBuffer input;
+        input.load(file);
+        return input;
+    }
+
+    InputBuffer(InputBuffer&& other) noexcept : owned(move(other.owned)), mapped(other.mapped), length(other.length) {
+        other.mapped = nullptr;
+        other.length = 0;
+    }
+    InputBuffer(const InputBuffer&) = delete;
+    InputBuffer& operator=(const InputBuffer&) = delete;
+
+    ~InputBuffer() {
+#if DARWIN_MMAP
+        if (mapped) {
+            munmap(mapped, length);
+        }
+#endif
+    }
+
+    string_view text() const {
+        return mapped ? string_view(static_cast<const char*>(mapped), length) : string_view(owned);
+    }
+
+private:
+    InputBuffer() = default;
+
+    string owned;
+    void* mapped = nullptr;
+    size_t length = 0;
+
+    void load(FILE* file) {
+#if DARWIN_MMAP
+        struct stat info;
+        const int fd = fileno(file);
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void* p = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                mapped = p;
+                length = info.st_size;
+                return;
+            }
+        }
+#endif
+        char block[1 << 16];
+        size_t n;
+        while ((n = fread(block, 1, sizeof(block), file)) > 0) {
+            owned.append(block, n);
+        }
+    }
+};
+
+// snapshot layout, version 1, every field in the byte order of the machine
+// that wrote it:
+//   "DRWNSNAP", u32 version, u32 0x01020304 to tell the byte order
+//   i32 rows, i32 cols, i32 turn, the Random state
+//   u32 species, each a u32 length name, u32 program length and a u32 op
+//       and i32 param per instruction, a name with no program was only
+//       ever named by a creature
+//   u32 creatures, then their species (u16), direction (u8), pc (u16) and
+//       padded grid cell (i32) as four arrays, the way CreatureStore has them
+inline constexpr char SNAPSHOT_MAGIC[8] = {'D', 'R', 'W', 'N', 'S', 'N', 'A', 'P'};
+inline constexpr uint32_t SNAPSHOT_VERSION = 1;
+inline constexpr uint32_t SNAPSHOT_ORDER = 0x01020304;
+
+inline string Darwin::snapshot() const {
+    SnapshotWriter out;
+    for (char c : SNAPSHOT_MAGIC) {
+        out.put(c);
+    }
+    out.put(SNAPSHOT_VERSION);
+    out.put(SNAPSHOT_ORDER);
+    out.put(static_cast<int32_t>(rows));
+    out.put(static_cast<int32_t>(cols));
+    out.put(static_cast<int32_t>(turn_number));
+    random.save(out);
+
+    out.put(static_cast<uint32_t>(species.size()));
+    for (int sp = 0; sp < species.size(); sp++) {
+        out.put_string(species.name(sp));
+        const vector<Instruction>& program = species.get(sp).get_program();
+        out.put(static_cast<uint32_t>(program.size()));
+        for (const Instruction& inst : program) {
+            out.put(static_cast<uint32_t>(inst.type));
+            out.put(static_cast<int32_t>(inst.param));
+        }
+    }
+
+    out.put(static_cast<uint32_t>(creatures.size()));
+    out.put_array(creatures.species);
+    out.put_array(creatures.direction);
+    out.put_array(creatures.pc);
+    out.put_array(creatures.cell);
+    return out.data();
+}
+
+inline void Darwin::restore(string_view data, const string& source) {
+    SnapshotReader in(data, source);
+    for (char c : SNAPSHOT_MAGIC) {
+        if (in.get<char>() != c) {
+            in.fail("not a Darwin snapshot");
+        }
+    }
+    const uint32_t version = in.get<uint32_t>();
+    if (version != SNAPSHOT_VERSION) {
+        in.fail("snapshot version " + to_string(version) + ", expected " + to_string(SNAPSHOT_VERSION));
+    }
+    if (in.get<uint32_t>() != SNAPSHOT_ORDER) {
+        in.fail("snapshot written with the other byte order");
+    }
+    const int r = in.get<int32_t>();
+    const int c = in.get<int32_t>();
+    if (r != rows || c != cols) {
+        in.fail("snapshot of a " + to_string(r) + "x" + to_string(c) + " board, this one is " +
+                to_string(rows) + "x" + to_string(cols));
+    }
+    const int turn = in.get<int32_t>();
+    if (turn < 0) {
+        in.fail("negative turn");
+    }
+    Random rng;
+    rng.load(in);
+
+    // everything's built off to the side so a bad snapshot leaves the world alone
+    SpeciesRegistry registry;
+    vector<Runner> runners;
+    const uint32_t species_count = in.get<uint32_t>();
+    for (uint32_t sp = 0; sp < species_count; sp++) {
+        const string name(in.get_string());
+        Species program;
+        for (uint32_t n = in.get<uint32_t>(), i = 0; i < n; i++) {
+            const uint32_t type = in.get<uint32_t>();
+            const int32_t param = in.get<int32_t>();
+            if (type > Instruction::GO) {
+                in.fail("species " + name + ": unknown instruction " + to_string(type));
+            }
+            program.add_instruction(static_cast<Instruction::Type>(type), param);
+        }
+        const int id = program.get_program().empty() ? registry.intern(name) : registry.define(name, program);
+        if (id != static_cast<int>(sp)) {
+            in.fail("species " + name + " is in there twice");
+        }
+        runners.push_back(specialize(program));
+    }
+
+    CreatureStore store;
+    const uint32_t n = in.get<uint32_t>();
+    in.get_array(store.species, n);
+    in.get_array(store.direction, n);
+    in.get_array(store.pc, n);
+    in.get_array(store.cell, n);
+    if (!in.done()) {
+        in.fail("junk after the snapshot");
+    }
+
+    Grid<int> board(rows, cols, EMPTY, WALL);
+    CellSet taken(static_cast<int>(board.data().size()));
+    vector<int> counts(registry.size(), 0);
+    for (int id = 0; id < static_cast<int>(n); id++) {
+        const int k = store.cell[id];
+        const int sp = store.species[id];
+        if (k < 0 || k >= static_cast<int>(board.data().size()) || board[k] != EMPTY) {
+            in.fail("creature " + to_string(id) + " is off the board or on top of another one");
+        }
+        if (sp >= registry.size() || store.direction[id] > CreatureStore::WEST ||
+                store.pc[id] >= max(1, registry.code(sp).size())) {
+            in.fail("creature " + to_string(id) + " has a bad species, direction or pc");
+        }
+        board[k] = id;
+        taken.insert(k);
+        counts[sp]++;
+    }
+
+    grid = move(board);
+    occupied = move(taken);
+    creatures = move(store);
+    recode();
+    handles.clear();
+    for (int id = 0; id < static_cast<int>(n); id++) {
+        handles.emplace_back(this, id);
+    }
+    species = move(registry);
+    specialized = move(runners);
+    population = move(counts);
+    random = rng;
+    turn_number = turn;
+    cycle.clear();
+    hashing = false;
+    rehash();
+}
+
+inline void Darwin::save(const string& path) const {
+    const string data = snapshot();
+    const string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) {
+        throw invalid_argument(temporary + ": can't write snapshot");
+    }
+    const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    if (fclose(file) != 0 || !written || rename(temporary.c_str(), path.c_str()) != 0) {
+        remove(temporary.c_str());
+        throw invalid_argument(path + ": can't write snapshot");
+    }
+}
+
+inline void Darwin::load(const string& path) {
+    const InputBuffer input = InputBuffer::open(path);
+    restore(input.text(), path);
+}
+
+// one test case from the batch input
+struct WorldSpec {
+    struct Placement {
+        string_view species;  // points back into the input text
+        int row, col;
+        char dir;
+        int line;             // where it came from, for error messages
+    };
+
+    string source = "input";  // the name the reader was given, for error messages
+    int rows = 0, cols = 0;
+    vector<Placement> creatures;
+    int turns = 0, freq = 1;
+};
+
+// pulls test cases out of the batch format (t, then for each case the board
+// size, n, n creature lines and turns/frequency) without any iostreams, line
+// breaks are just whitespace so stray blank lines don't matter
+class WorldReader {
+public:
+
+    // reads the test case count, throws invalid_argument on bad input
+    WorldReader(string_view t, string src = "input") : text(t), source(move(src)) {
+        total = number(1, 1 << 30, "the number of test cases");
+    }
+
+    // how many test cases the input says it has
+    int size() const {
+        return total;
+    }
+
+    // fills in the next test case, false once they've all been read
+    bool next(WorldSpec& spec) {
+        if (done == total) {
+            return false;
+        }
+        spec.source = source;
+        spec.rows = number(1, 1 << 15, "the number of rows");
+        spec.cols = number(1, 1 << 15, "the number of columns");
+        const int n = number(0, 1 << 30, "the number of creatures");
+        spec.creatures.clear();
+        spec.creatures.reserve(n);
+        for (int i = 0; i < n; i++) {
+            WorldSpec::Placement p;
+            p.species = word("a species");
+            p.line = line;
+            p.row = number(0, spec.rows - 1, "row", spec.rows);
+            p.col = number(0, spec.cols - 1, "column", spec.cols);
+            string_view dir = word("a direction");
+            if (dir.size() != 1 || string_view("nesw").find(dir[0]) == string_view::npos) {
+                fail("expected a direction (n, e, s or w) but found \"" + string(dir) + "\"");
+            }
+            p.dir = dir[0];
+            spec.creatures.push_back(p);
+        }
+        spec.turns = number(0, 1 << 30, "the number of turns");
+        spec.freq = number(1, 1 << 30, "the printing frequency");
+        done++;
+        return true;
+    }
+
+private:
+    string_view text;
+    string source;
+    size_t pos = 0;
+    int line = 1;
+    int total = 0, done = 0;
+
+    [[noreturn]] void fail(const string& why) const {
+        throw invalid_argument(source + ":" + to_string(line) + ": " + why);
+    }
+
+    // what was expected and what came instead. with a board size, what is a
+    // row or column on a board that big. the message only gets put together
+    // here so reading good input never builds one
+    [[noreturn]] void fail(const char* what, int board, const string& found) const {
+        if (board > 0) {
+            fail("expected a " + string(what) + " on a " + to_string(board) + " " + what + " board but " + found);
+        }
+        fail("expected " + string(what) + " but " + found);
+    }
+
+    // the next run of non whitespace, counting line breaks on the way
+    string_view word(const char* what, int board = 0) {
+        while (pos < text.size() && static_cast<unsigned char>(text[pos]) <= ' ') {
+            if (text[pos] == '\n') {
+                line++;
+            }
+            pos++;
+        }
+        const size_t start = pos;
+        while (pos < text.size() && static_cast<unsigned char>(text[pos]) > ' ') {
+            pos++;
+        }
+        if (start == pos) {
+            fail(what, board, "the input ended");
+        }
+        return text.substr(start, pos - start);
+    }
+
+    int number(int lo, int hi, const char* what, int board = 0) {
+        string_view w = word(what, board);
+        int value = 0;
+        auto [ptr, ec] = from_chars(w.data(), w.data() + w.size(), value);
+        if (ec != errc() || ptr != w.data() + w.size()) {
+            fail(what, board, "found \"" + string(w) + "\"");
+        }
+        if (value < lo || value > hi) {
+            fail(what, board, "found " + to_string(value));
+        }
+        return value;
+    }
+};
+
+// every test case in text, throws invalid_argument on bad input. the species
+// point back into text, so it has to outlive them
+inline vector<WorldSpec> read_batch(string_view text, const string& source = "input") {
+    WorldReader reader(text, source);
+    vector<WorldSpec> specs(reader.size());
+    for (WorldSpec& spec : specs) {
+        reader.next(spec);
+    }
+    return specs;
+}
+
+// an ostream whose bytes get written to sink by a thread of its own, so the
+// simulation can render the next frames while the last ones are still going
+// out. what's written collects in a buffer until it holds chunk bytes, then
+// goes on a ring of depth buffers the writer drains in order and hands back
+// cleared, so they keep their memory. the ring is lock free, one side only
+// ever moves head and the other tail. a full ring makes the simulation wait
+// for the writer, depth says how far ahead of the output it's allowed to get
+class FrameWriter : private streambuf, public ostream {
+public:
+
+    explicit FrameWriter(ostream& out, int depth = 8, size_t chunk = 1 << 16)
+        : ostream(static_cast<streambuf*>(this)), sink(out), slots(max(depth, 1)), last(slots.size(), 0),
+          chunk(chunk), writer([this]() {
+        drain();
+    }) {}
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    ~FrameWriter() {
+        close();
+    }
+
+    // sends whatever is buffered, waits for all of it to be written and
+    // flushes sink, nothing can be written after this
+    void close() {
+        if (writer.joinable()) {
+            publish(true);
+            writer.join();
+            sink.flush();
+        }
+    }
+
+private:
+    ostream& sink;
+    vector<string> slots;
+    vector<char> last;              // the slot close() sent, the writer stops after it
+    size_t chunk;
+    atomic<size_t> head {0};        // slots ever handed to the writer
+    atomic<size_t> tail {0};        // slots ever written out
+    size_t filling = 0;             // the producer's own copy of head
+    string* current = nullptr;      // the slot being filled, if there is one
+    thread writer;
+
+    // waits for the writer to give back the slot after the last one sent
+    string& claim() {
+        if (!current) {
+            for (size_t t = tail.load(memory_order_acquire); filling - t >= slots.size(); t = tail.load(memory_order_acquire)) {
+                tail.wait(t, memory_order_acquire);
+            }
+            current = &slots[filling % slots.size()];
+        }
+        return *current;
+    }
+
+    void publish(bool final) {
+        claim();
+        last[filling % slots.size()] = final;
+        current = nullptr;
+        head.store(++filling, memory_order_release);
+        head.notify_one();
+    }
+
+    void drain() {
+        for (size_t t = 0;;) {
+            size_t h = head.load(memory_order_acquire);
+            for (; h == t; h = head.load(memory_order_acquire)) {
+                head.wait(h, memory_order_acquire);
+            }
+            for (; t < h; t++) {
+                string& slot = slots[t % slots.size()];
+                const bool final = last[t % slots.size()];
+                sink.write(slot.data(), slot.size());
+                slot.clear();
+                tail.store(t + 1, memory_order_release);
+                tail.notify_one();
+                if (final) {
+                    return;
+                }
+            }
+        }
+    }
+
+    streamsize xsputn(const char* s, streamsize n) override {
+        string& slot = claim();
+        slot.append(s, n);
+        if (slot.size() >= chunk) {
+            publish(false);
+        }
+        return n;
+    }
+
+    streambuf::int_type overflow(streambuf::int_type c) override {
+        using traits = streambuf::traits_type;
+        if (!traits::eq_int_type(c, traits::eof())) {
+            const char ch = traits::to_char_type(c);
+            xsputn(&ch, 1);
+        }
+        return traits::not_eof(c);
+    }
+
+    // a flush hands over a part filled buffer but doesn't wait for it
+    int sync() override {
+        if (current && !current->empty()) {
+            publish(false);
+        }
+        return 0;
+    }
+};
+
+// the species every board in a batch starts with, by name
+using SpeciesLibrary = map<string, Species>;
+
+// the built in species under the names the sample input uses
+inline SpeciesLibrary builtin_library() {
+    return {{"f", Species(builtin::FOOD)}, {"h", Species(builtin::HOPPER)},
+        {"r", Species(builtin::ROVER)}, {"t", Species(builtin::TRAP)}
+    };
+}
+
+// loads every NAME.spc in dir as species NAME, replacing any already in
+// library with the same name
+inline void load_library(const string& dir, SpeciesLibrary& library) {
+    for (const auto& entry : filesystem::directory_iterator(dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".spc") {
+            library[entry.path().stem().string()] = Species::load(entry.path().string());
+        }
+    }
+}
+
+// how run_batch sets up and runs the boards
+struct RunOptions {
+    int jobs = 1;                               // test cases simulated at once
+    Random::Mode random = Random::COMPATIBLE;   // every board starts from the same seed
+    uint64_t seed = 0;
+    Darwin::Format format = Darwin::TEXT;
+    int threads = 1;                            // threads each board's turns are split over
+    Darwin::Update update = Darwin::SWEEP;
+    int buffers = 8;                            // output buffers a FrameWriter can fall behind by, 0 writes inline
+    string checkpoint;                          // directory for a caseN.snap per test case, empty for none
+    int checkpoint_every = 100;                 // turns between snapshots
+    bool resume = false;                        // cases with a snapshot pick up from it instead of turn 0
+    vector<Stats>* stats = nullptr;             // gets every case's Stats when set
+};
+
+// simulates with snapshots going to options.checkpoint, or carries on from
+// one. a resumed case only prints the frames after its snapshot's turn
+inline void run_checkpointed(Darwin& darwin, const WorldSpec& spec, int test, int total, const RunOptions& options) {
+    const string path = options.checkpoint + "/case" + to_string(test) + ".snap";
+    darwin.set_checkpoint(path, options.checkpoint_every);
+    if (options.resume && ifstream(path)) {
+        darwin.load(path);
+        darwin.resume(spec.turns, spec.freq, test, total);
+    } else {
+        darwin.simulate(spec.turns, spec.freq, test, total);
+    }
+}
+
+// builds and simulates one test case, writing its frames to out
+inline void run_world(const WorldSpec& spec, const SpeciesLibrary& library, ostream& out, int test, int total,
+                      const RunOptions& options = RunOptions()) {
+    Darwin darwin(spec.rows, spec.cols);
+    darwin.set_output(out);
+    darwin.set_format(options.format);
+    darwin.set_threads(options.threads);
+    darwin.set_update(options.update);
+    darwin.seed_random(options.seed, options.random);
+    for (const auto& [name, species] : library) {
+        darwin.add_species(name, species);
+    }
+    for (const WorldSpec::Placement& p : spec.creatures) {
+        darwin.add_creature(string(p.species), p.row, p.col, p.dir);
+    }
+    if (options.checkpoint.empty()) {
+        darwin.simulate(spec.turns, spec.freq, test, total);
+    } else {
+        run_checkpointed(darwin, spec, test, total, options);
+    }
+    if (options.stats) {
+        (*options.stats)[test] = darwin.get_stats();
+    }
+}
+
+// runs a whole batch and writes the test cases out in order. with options.jobs > 1
+// the cases are simulated on that many threads, each one is written as soon
+// as it and everything before it are done. every board has its own Random so
+// the output doesn't depend on which thread ran what. with options.buffers > 0
+// the output goes out through a FrameWriter. throws invalid_argument up
+// front for a creature of a species that isn't in the library
+inline void run_batch(const vector<WorldSpec>& specs, const SpeciesLibrary& library, ostream& out,
+                      const RunOptions& options = RunOptions()) {
+    for (const WorldSpec& spec : specs) {
+        for (const WorldSpec::Placement& p : spec.creatures) {
+            if (!library.count(string(p.species))) {
+                throw invalid_argument(spec.source + ":" + to_string(p.line) + ": unknown species \"" + string(p.species) + "\"");
+            }
+        }
+    }
+
+    if (options.stats) {
+        options.stats->assign(specs.size(), Stats());
+    }
+    if (options.buffers > 0) {
+        FrameWriter writer(out, options.buffers);
+        RunOptions inline_output = options;
+        inline_output.buffers = 0;
+        run_batch(specs, library, writer, inline_output);
+        writer.close();
+        return;
+    }
+
+    const int total = static_cast<int>(specs.size());
+    const int jobs = options.jobs;
+    if (jobs <= 1 || total <= 1) {
+        for (int test = 0; test < total; test++) {
+            run_world(specs[test], library, out, test, total, options);
+        }
+        return;
+    }
+
+    vector<string> results(total);
+    vector<bool> ready(total, false);
+    vector<exception_ptr> errors(total);
+    atomic<int> next_case(0);
+    mutex lock;
+    condition_variable done;
+
+    // a case that throws is ready too, with its exception in place of frames
+    auto work = [&]() {
+        for (int test = next_case++; test < total; test = next_case++) {
+            ostringstream frames;
+            exception_ptr error;
+            try {
+                run_world(specs[test], library, frames, test, total, options);
+            } catch (...) {
+                error = current_exception();
+            }
+            lock_guard<mutex> guard(lock);
+            results[test] = frames.str();
+            errors[test] = error;
+            ready[test] = true;
+            done.notify_all();
+        }
+    };
+
+    vector<thread> workers;
+    for (int i = 0; i < min(jobs, total); i++) {
+        workers.emplace_back(work);
+    }
+    // the cases before a failed one still go out, same as with one job
+    exception_ptr failed;
+    for (int test = 0; test < total && !failed; test++) {
+        string frames;
+        {
+            unique_lock<mutex> guard(lock);
+            done.wait(guard, [&]() {
+                return ready[test];
+            });
+            frames.swap(results[test]);
+            failed = errors[test];
+        }
+        if (failed) {
+            next_case = total;  // nothing new gets started
+        } else {
+            out.write(frames.data(), frames.size());
+        }
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    if (failed) {
+        rethrow_exception(failed);
+    }
+}
+
+// writes out the Stats run_batch collected, a record per test case and one
+// for all of them added up. the CSV is long form, "case,turn,name,value":
+// the counters have no turn and the populations are a row per species per
+// turn. the JSON has the same things under the same names
+inline void write_stats(ostream& out, const vector<Stats>& cases, bool json) {
+    Stats total;
+    for (const Stats& stats : cases) {
+        total.merge(stats);
+    }
+
+    auto counters = [](const Stats& stats) {
+        vector<pair<string, uint64_t>> named = {
+            {"actions", stats.actions}, {"instructions", stats.instructions()},
+            {"hops_blocked", stats.hops_blocked}, {"infections", stats.infections}
+        };
+        for (int op = 0; op <= Instruction::GO; op++) {
+            named.emplace_back(string(Instruction::NAMES[op]), stats.ops[op]);
+        }
+        return named;
+    };
+
+    // species names come from file names, so they can have anything in them
+    auto csv_field = [](const string& name) {
+        if (name.find_first_of(",\"\r\n") == string::npos) {
+            return name;
+        }
+        string quoted = "\"";
+        for (char c : name) {
+            quoted += c == '"' ? "\"\"" : string(1, c);
+        }
+        return quoted + "\"";
+    };
+    auto json_string = [](const string& name) {
+        string quoted = "\"";
+        for (char c : name) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+                quoted += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                quoted += escape;
+            } else {
+                quoted += c;
+            }
+        }
+        return quoted + "\"";
+    };
+
+    if (!json) {
+        out << "case,turn,name,value\n";
+        for (int test = 0; test <= static_cast<int>(cases.size()); test++) {
+            const bool all = test == static_cast<int>(cases.size());
+            const Stats& stats = all ? total : cases[test];
+            const string label = all ? "all" : to_string(test);
+            for (const auto& [name, value] : counters(stats)) {
+                out << label << ",," << name << "," << value << "\n";
+            }
+            for (size_t t = 0; t < stats.population.size(); t++) {
+                for (size_t sp = 0; sp < stats.population[t].size(); sp++) {
+                    out << label << "," << stats.first_turn + t << "," << csv_field(stats.species[sp]) << "," << stats.population[t][sp] << "\n";
+                }
+            }
+        }
+        return;
+    }
+
+    auto object = [&](const Stats& stats) {
+        out << "{";
+        for (const auto& [name, value] : counters(stats)) {
+            out << "\"" << name << "\": " << value << ", ";
+        }
+        out << "\"first_turn\": " << stats.first_turn << ", \"population\": {";
+        for (size_t sp = 0; sp < stats.species.size(); sp++) {
+            out << (sp ? ", " : "") << json_string(stats.species[sp]) << ": [";
+            for (size_t t = 0; t < stats.population.size(); t++) {
+                out << (t ? ", " : "") << stats.population[t][sp];
+            }
+            out << "]";
+        }
+        out << "}}";
+    };
+    out << "{\"cases\": [";
+    for (size_t test = 0; test < cases.size(); test++) {
+        out << (test ? ",\n  " : "\n  ");
+        object(cases[test]);
+    }
+    out << "],\n\"all\": ";
+    object(total);
+    out << "}\n";
+}
+
+// writes out what Darwin::TEXT would have printed for a run printed as
+// Darwin::DELTA. headers, full frames and blank lines are copied, a delta
+// frame has its changes put on the last frame, checking each cell's old
+// species on the way. throws invalid_argument naming the source and line on
+// anything it doesn't follow
+inline void decode_frames(string_view text, ostream& out, const string& source = "input") {
+    size_t at = 0;
+    int line_number = 0;
+    auto fail = [&](const string& why) {
+        throw invalid_argument(source + ":" + to_string(line_number) + ": " + why);
+    };
+    auto next_line = [&](string_view& line) {
+        if (at >= text.size()) {
+            return false;
+        }
+        size_t end = text.find('\n', at);
+        if (end == string_view::npos) {
+            end = text.size();
+        }
+        line = text.substr(at, end - at);
+        at = end + 1;
+        line_number++;
+        return true;
+    };
+    auto number = [&](string_view& rest, int& value) {
+        while (!rest.empty() && rest.front() == ' ') {
+            rest.remove_prefix(1);
+        }
+        const auto [end, error] = from_chars(rest.data(), rest.data() + rest.size(), value);
+        if (error != errc() || value < 0) {
+            fail("expected a number");
+        }
+        rest.remove_prefix(end - rest.data());
+    };
+
+    int rows = -1, cols = 0;
+    string frame;   // the last frame's body, the same layout FrameRenderer uses
+    string_view line;
+    while (next_line(line)) {
+        if (line.empty()) {
+            out << '\n';
+            continue;
+        }
+        if (line.starts_with("*** Darwin ")) {
+            string_view rest = line.substr(11);
+            number(rest, rows);
+            if (!rest.starts_with("x")) {
+                fail("expected RxC in the header");
+            }
+            rest.remove_prefix(1);
+            number(rest, cols);
+            frame.clear();
+            out << line << '\n';
+            continue;
+        }
+        if (!line.starts_with("Turn = ") || rows < 0) {
+            fail("expected a header or a frame");
+        }
+        string_view rest = line.substr(7);
+        int turn;
+        number(rest, turn);
+        if (rest == ".") {
+            // a full frame
+            out << line << '\n';
+            frame.clear();
+            for (int i = 0; i <= rows; i++) {
+                if (!next_line(line) || line.size() != static_cast<size_t>(cols + 2)) {
+                    fail("frame row is the wrong length");
+                }
+                frame.append(line);
+                frame += '\n';
+            }
+            out << frame;
+            continue;
+        }
+
+        int changes;
+        if (!rest.starts_with(". ") || frame.empty()) {
+            fail("a delta frame has to come after a full one");
+        }
+        rest.remove_prefix(1);
+        number(rest, changes);
+        for (int n = 0; n < changes; n++) {
+            int i, j;
+            if (!next_line(rest)) {
+                fail("frame is cut short");
+            }
+            number(rest, i);
+            number(rest, j);
+            if (i >= rows || j >= cols || rest.size() != 4 || rest[0] != ' ' || rest[2] != ' ') {
+                fail("expected \"row col old new\"");
+            }
+            char& cell = frame[(i + 1) * static_cast<size_t>(cols + 3) + 2 + j];
+            if (cell != rest[1]) {
+                fail("cell " + to_string(i) + " " + to_string(j) + " was '" + string(1, cell) + "'");
+            }
+            cell = rest[3];
+        }
+        out << "Turn = " << turn << ".\n" << frame;
+    }
 }
 
-#endif // Darwin_hpp
\ No newline at end of file
+#endif // Darwin_hpp
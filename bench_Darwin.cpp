@@ -0,0 +1,125 @@
+#include <string>    // string
+#include <vector>    // vector
+
+#include "benchmark/benchmark.h"
+
+#include "Darwin.hpp"
+#include "sample_Darwin.hpp"
+
+using namespace std;
+
+// run with --benchmark_out=FILE --benchmark_out_format=json to keep the
+// numbers around, make bench does that
+
+namespace {
+
+// swallows output so the benchmarks time the rendering and not a terminal
+class NullBuffer : public streambuf {
+protected:
+    streamsize xsputn(const char*, streamsize n) override {
+        return n;
+    }
+    int_type overflow(int_type c) override {
+        return traits_type::not_eof(c);
+    }
+};
+
+NullBuffer null_buffer;
+ostream null_out(&null_buffer);
+
+const char* const NAMES[] = {"f", "h", "r", "t"};
+
+void add_builtins(Darwin& darwin) {
+    for (const auto& [name, species] : builtin_library()) {
+        darwin.add_species(name, species);
+    }
+}
+
+// a size x size board with density percent of its cells taken, the same
+// board for the same arguments
+void populate(Darwin& darwin, int size, int density) {
+    Random random(size * 1000 + density);
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            if (random.next() % 100 < density) {
+                darwin.add_creature(NAMES[random.next() % 4], i, j, "nesw"[random.next() % 4]);
+            }
+        }
+    }
+}
+
+}
+
+// one creature of each species on a board of its own, so every turn is a
+// run of its program against the walls
+static void BM_ExecuteTurn(benchmark::State& state) {
+    Darwin darwin(1, 1);
+    add_builtins(darwin);
+    darwin.add_creature(NAMES[state.range(0)], 0, 0, 'e');
+    Creature* creature = darwin.get_creature(0, 0);
+    int turn = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(creature->execute_turn(darwin, 0, 0, ++turn));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(NAMES[state.range(0)]);
+}
+BENCHMARK(BM_ExecuteTurn)->DenseRange(0, 3);
+
+// whole turns over a board, args are the side and the percent of cells taken
+static void BM_Step(benchmark::State& state) {
+    const int size = state.range(0);
+    Darwin darwin(size, size);
+    add_builtins(darwin);
+    populate(darwin, size, state.range(1));
+    const int creatures = darwin.get_creatures().size();
+    for (auto _ : state) {
+        darwin.step();
+    }
+    state.SetItemsProcessed(state.iterations() * creatures);
+}
+BENCHMARK(BM_Step)->ArgsProduct({{20, 50, 100, 200}, {2, 50}});
+
+// the same with every creature deciding from the board as the turn started
+static void BM_StepSynchronous(benchmark::State& state) {
+    const int size = state.range(0);
+    Darwin darwin(size, size);
+    darwin.set_update(Darwin::SYNCHRONOUS);
+    add_builtins(darwin);
+    populate(darwin, size, state.range(1));
+    const int creatures = darwin.get_creatures().size();
+    for (auto _ : state) {
+        darwin.step();
+    }
+    state.SetItemsProcessed(state.iterations() * creatures);
+}
+BENCHMARK(BM_StepSynchronous)->ArgsProduct({{50, 200}, {2, 50}});
+
+// drawing and writing one frame of a half full board
+static void BM_PrintGrid(benchmark::State& state) {
+    const int size = state.range(0);
+    Darwin darwin(size, size);
+    add_builtins(darwin);
+    populate(darwin, size, 50);
+    darwin.set_output(null_out);
+    for (auto _ : state) {
+        darwin.simulate(0, 1, 0, 1);
+    }
+    state.SetBytesProcessed(state.iterations() * (size + 1) * (size + 3));
+}
+BENCHMARK(BM_PrintGrid)->Arg(20)->Arg(100)->Arg(200);
+
+// the whole sample input the way run_Darwin runs it, the arg is the number
+// of output buffers (0 writes inline)
+static void BM_EndToEnd(benchmark::State& state) {
+    const vector<WorldSpec> specs = read_specs();
+    const SpeciesLibrary library = builtin_library();
+    RunOptions options;
+    options.buffers = state.range(0);
+    for (auto _ : state) {
+        run_batch(specs, library, null_out, options);
+    }
+}
+BENCHMARK(BM_EndToEnd)->Arg(0)->Arg(8)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,17 @@
+#include <iostream>
+#include "Darwin.hpp"
+
+using namespace std;
+
+// turns the output of run_Darwin --delta back into the usual frames
+int main() {
+    try {
+        const InputBuffer input = InputBuffer::read(stdin);
+        decode_frames(input.text(), cout, "stdin");
+    } catch (const exception& e) {
+        cout.flush();
+        cerr << "decode_Darwin: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
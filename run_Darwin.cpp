@@ -3,6 +3,7 @@
 #include <string>
 #include <map>
 #include <cstdlib>
+#include <fstream>
 #include "Darwin.hpp"
 
 using namespace std;
@@ -13,70 +14,95 @@ class Creature;
 class Species;
 class Darwin;
 
-int main() {
-    // provides all the instructions for the specific darwin cases provided
-    Species food, hopper, rover, trap;
-
-    food.add_instruction(Instruction::LEFT);
-    food.add_instruction(Instruction::GO, 0);
-
-    hopper.add_instruction(Instruction::HOP);
-    hopper.add_instruction(Instruction::GO, 0);
-
-    rover.add_instruction(Instruction::IF_ENEMY, 9);
-    rover.add_instruction(Instruction::IF_EMPTY, 7);
-    rover.add_instruction(Instruction::IF_RANDOM, 5);
-    rover.add_instruction(Instruction::LEFT);
-    rover.add_instruction(Instruction::GO, 0);
-    rover.add_instruction(Instruction::RIGHT);
-    rover.add_instruction(Instruction::GO, 0);
-    rover.add_instruction(Instruction::HOP);
-    rover.add_instruction(Instruction::GO, 0);
-    rover.add_instruction(Instruction::INFECT);
-    rover.add_instruction(Instruction::GO, 0);
-
-    trap.add_instruction(Instruction::IF_ENEMY, 3);
-    trap.add_instruction(Instruction::LEFT);
-    trap.add_instruction(Instruction::GO, 0);
-    trap.add_instruction(Instruction::INFECT);
-    trap.add_instruction(Instruction::GO, 0);
-
-    int t;
-    cin >> t;
-    cin.ignore(); // Skip the newline after t
-
-    for (int test = 0; test < t; test++) {
-        if (test > 0) cin.ignore();
-
-        int rows, cols;
-        cin >> rows >> cols;
-
-        // creates the board and the species possible
-        Darwin darwin(rows, cols);
-
-        darwin.add_species("f", food);
-        darwin.add_species("h", hopper);
-        darwin.add_species("r", rover);
-        darwin.add_species("t", trap);
-
-        int n;
-        cin >> n;
-        for (int i = 0; i < n; i++) {
-            char type;
-            int row, col;
-            char dir;
-            cin >> type >> row >> col >> dir;
-            // makes the specific creatures obtained from the in txt
-            string species_name(1, type);
-            darwin.add_creature(species_name, row, col, dir);
+int main(int argc, char* argv[]) {
+    // provides all the instructions for the specific darwin cases provided,
+    // Darwin runs these through interpreters generated for them
+    SpeciesLibrary library = builtin_library();
+    RunOptions options;
+    string stats_path;
+    vector<Stats> stats;
+    const string usage = "usage: run_Darwin [--species DIR] [--jobs N] [--threads N] [--random compatible|fast|keyed] [--seed N] [--buffers N] [--delta]\n"
+                         "                  [--synchronous] [--checkpoint DIR [--every N] [--resume]] [--stats FILE.csv|FILE.json] < input";
+
+    // run_Darwin [--species DIR] [--jobs N] [--threads N] [--random compatible|fast|keyed] [--seed N] [--buffers N] [--delta]
+    //            [--synchronous] [--checkpoint DIR [--every N] [--resume]] [--stats FILE.csv|FILE.json] < input
+    try {
+        for (int i = 1; i < argc; i++) {
+            const string arg = argv[i];
+            if (arg == "--species" && i + 1 < argc) {
+                load_library(argv[++i], library);
+            } else if ((arg == "--jobs" || arg == "-j") && i + 1 < argc) {
+                options.jobs = stoi(argv[++i]);
+            } else if (arg == "--threads" && i + 1 < argc) {
+                options.threads = stoi(argv[++i]);
+            } else if (arg == "--random" && i + 1 < argc) {
+                const string mode = argv[++i];
+                if (mode != "compatible" && mode != "fast" && mode != "keyed") {
+                    cerr << usage << endl;
+                    return 1;
+                }
+                options.random = mode == "fast" ? Random::FAST : mode == "keyed" ? Random::KEYED : Random::COMPATIBLE;
+            } else if (arg == "--seed" && i + 1 < argc) {
+                options.seed = stoull(argv[++i]);
+            } else if (arg == "--buffers" && i + 1 < argc) {
+                options.buffers = stoi(argv[++i]);
+            } else if (arg == "--checkpoint" && i + 1 < argc) {
+                options.checkpoint = argv[++i];
+            } else if (arg == "--every" && i + 1 < argc) {
+                options.checkpoint_every = stoi(argv[++i]);
+            } else if (arg == "--resume") {
+                options.resume = true;
+            } else if (arg == "--delta") {
+                options.format = Darwin::DELTA;
+            } else if (arg == "--synchronous") {
+                options.update = Darwin::SYNCHRONOUS;
+            } else if (arg == "--stats" && i + 1 < argc) {
+#ifdef DARWIN_STATS
+                stats_path = argv[++i];
+#else
+                throw invalid_argument("--stats needs a build with DARWIN_STATS defined (make STATS=1)");
+#endif
+            } else {
+                cerr << usage << endl;
+                return 1;
+            }
         }
+        // catches a bad program before any world gets built
+        for (const auto& [name, species] : library) {
+            const Species::Analysis analysis = species.analyze();
+            if (!analysis.ok()) {
+                throw invalid_argument("species " + name + ": " + analysis.errors.front());
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "run_Darwin: " << e.what() << endl;
+        return 1;
+    }
 
-        int turns, freq;
-        cin >> turns >> freq;
+    try {
+        const InputBuffer input = InputBuffer::read(stdin);
+
+        // every test case is read before any of them run, so a bad line
+        // shows up before there's any output
+        const vector<WorldSpec> specs = read_batch(input.text(), "stdin");
 
         // simulates the turns and prints at whatever frequency provided
-        darwin.simulate(turns, freq, test, t);
+        if (!stats_path.empty()) {
+            options.stats = &stats;
+        }
+        run_batch(specs, library, cout, options);
+        if (!stats_path.empty()) {
+            ofstream file(stats_path);
+            write_stats(file, stats, stats_path.ends_with(".json"));
+            if (!file) {
+                throw invalid_argument(stats_path + ": can't write stats");
+            }
+        }
+    } catch (const exception& e) {
+        cout.flush();
+        cerr << "run_Darwin: " << e.what() << endl;
+        return 1;
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,32 @@
+#ifndef sample_Darwin_hpp
+#define sample_Darwin_hpp
+
+#include <string> // string
+#include <vector> // vector
+
+#include "Darwin.hpp"
+
+// the sample input and what run_Darwin prints for it, for test_Darwin and
+// bench_Darwin, both run from the top of the repo
+
+// every test case of the sample input, their species point into a copy of
+// the input that's kept for the whole run
+inline vector<WorldSpec> read_specs() {
+    static const InputBuffer input = InputBuffer::open("karahphang-Darwin.in.txt");
+    return read_batch(input.text(), "karahphang-Darwin.in.txt");
+}
+
+// what run_Darwin prints for the sample input
+inline string expected_output() {
+    const InputBuffer expected = InputBuffer::open("karahphang-Darwin.out.txt");
+    return string(expected.text());
+}
+
+// the .spc versions of the built in species, under the same names
+inline SpeciesLibrary spc_library() {
+    SpeciesLibrary library;
+    load_library("species", library);
+    return library;
+}
+
+#endif // sample_Darwin_hpp
@@ -4,7 +4,12 @@
 
 #include "gtest/gtest.h"
 
+// the tests check the counters too, make STATS=1 defines it already
+#ifndef DARWIN_STATS
+#define DARWIN_STATS
+#endif
 #include "Darwin.hpp"
+#include "sample_Darwin.hpp"
 
 using namespace std;
 
@@ -541,4 +546,1367 @@ TEST (DarwinRun, test9)
     darwin.simulate(921, 182, 1, 1);
 
     ASSERT_EQ(truth1, truth2);
-}
\ No newline at end of file
+}
+TEST (DarwinGrid, test0)
+{
+    Grid<int> grid(3, 4, 0, -1);
+
+    ASSERT_EQ(grid.get_stride(), 6);
+    ASSERT_EQ(grid.data().size(), 30u);
+    ASSERT_EQ(grid[grid.index(0, 0)], 0);
+    ASSERT_EQ(grid[grid.index(2, 3)], 0);
+
+    // one step off any edge is a wall
+    ASSERT_EQ(grid[grid.index(0, 0) - grid.get_stride()], -1);
+    ASSERT_EQ(grid[grid.index(0, 0) - 1], -1);
+    ASSERT_EQ(grid[grid.index(2, 3) + 1], -1);
+    ASSERT_EQ(grid[grid.index(2, 3) + grid.get_stride()], -1);
+}
+
+TEST (DarwinGrid, test1)
+{
+    Species hopper;
+    hopper.add_instruction(Instruction::HOP);
+    hopper.add_instruction(Instruction::GO, 0);
+
+    Darwin darwin(2, 3);
+    darwin.add_species("h", hopper);
+    darwin.add_creature("h", 0, 0, 'e');
+
+    Creature* c = darwin.get_creature(0, 0);
+    ASSERT_NE(c, nullptr);
+    ASSERT_EQ(darwin.get_creature(-1, 0), nullptr);
+    ASSERT_EQ(darwin.get_creature(0, 3), nullptr);
+
+    darwin.move_creature(0, 0, 1, 2);
+    ASSERT_EQ(darwin.get_creature(0, 0), nullptr);
+    ASSERT_EQ(darwin.get_creature(1, 2), c);
+    ASSERT_TRUE(darwin.is_wall(darwin.cell_index(1, 2) + 1));
+}
+
+TEST (DarwinStore, test0)
+{
+    CreatureStore store;
+
+    ASSERT_EQ(store.add(2, CreatureStore::to_code('w'), 7), 0);
+    ASSERT_EQ(store.add(1, CreatureStore::to_code('e'), 9), 1);
+    ASSERT_EQ(store.size(), 2);
+    ASSERT_EQ(store.species[0], 2);
+    ASSERT_EQ(CreatureStore::to_char(store.direction[0]), 'w');
+    ASSERT_EQ(store.cell[1], 9);
+
+    store.reset(0, 3, CreatureStore::SOUTH);
+    ASSERT_EQ(store.species[0], 3);
+    ASSERT_EQ(store.pc[0], 0);
+}
+
+TEST (DarwinStore, test1)
+{
+    Species food, hopper;
+    food.add_instruction(Instruction::LEFT);
+    food.add_instruction(Instruction::GO, 0);
+    hopper.add_instruction(Instruction::HOP);
+    hopper.add_instruction(Instruction::GO, 0);
+
+    Darwin darwin(3, 3);
+    darwin.add_species("f", food);
+    darwin.add_species("h", hopper);
+    darwin.add_creature("f", 1, 1, 'n');
+    darwin.add_creature("h", 0, 0, 's');
+
+    testing::internal::CaptureStdout();
+    darwin.simulate(1, 1, 0, 1);
+    testing::internal::GetCapturedStdout();
+
+    // the hopper went south once and the food turned to face west
+    ASSERT_EQ(darwin.get_creature(0, 0), nullptr);
+    ASSERT_EQ(darwin.get_creature(1, 0)->get_species_type(), "h");
+    ASSERT_EQ(darwin.get_creature(1, 1)->get_direction(), 'w');
+    ASSERT_EQ(darwin.get_creatures().size(), 2);
+    ASSERT_EQ(darwin.get_creatures().cell[1], darwin.cell_index(1, 0));
+
+    // looking things up still works through a const world
+    const Darwin& view = darwin;
+    ASSERT_EQ(view.get_creature(1, 0)->get_species_type(), "h");
+    ASSERT_EQ(view.get_creature(0, 0), nullptr);
+
+    // a pointer stays good while more creatures are added
+    Darwin big(40, 40);
+    big.add_species("f", food);
+    big.add_creature("f", 0, 0, 'e');
+    Creature* first = big.get_creature(0, 0);
+    for (int i = 1; i < 40 * 40; i++) {
+        big.add_creature("f", i / 40, i % 40, 'n');
+    }
+    ASSERT_EQ(big.get_creature(0, 0), first);
+    ASSERT_EQ(first->get_direction(), 'e');
+}
+
+TEST (DarwinStore, test2)
+{
+    // the characters only exist at the edges, and four quarter turns either
+    // way come back round
+    for (char dir : string("nesw")) {
+        const uint8_t code = CreatureStore::to_code(dir);
+        ASSERT_EQ(CreatureStore::to_char(code), dir);
+        ASSERT_EQ(CreatureStore::left_of(CreatureStore::right_of(code)), code);
+        uint8_t d = code;
+        for (int i = 0; i < 4; i++) {
+            d = CreatureStore::left_of(d);
+        }
+        ASSERT_EQ(d, code);
+    }
+    ASSERT_EQ(CreatureStore::left_of(CreatureStore::NORTH), CreatureStore::WEST);
+    ASSERT_EQ(CreatureStore::right_of(CreatureStore::WEST), CreatureStore::NORTH);
+}
+
+TEST (DarwinStore, test3)
+{
+    // the old set_species registers a program it's handed under a new name,
+    // and won't make up an empty one
+    Darwin darwin(1, 2);
+    darwin.add_species("f", Species(builtin::FOOD));
+    darwin.add_creature("f", 0, 0, 'e');
+    Creature* c = darwin.get_creature(0, 0);
+    ASSERT_THROW(c->set_species("x", nullptr), invalid_argument);
+    ASSERT_EQ(c->get_species_type(), "f");
+
+    const Species hopper(builtin::HOPPER);
+    c->set_species("h", &hopper);
+    ASSERT_EQ(c->get_species_type(), "h");
+    darwin.step();
+    ASSERT_NE(darwin.get_creature(0, 1), nullptr);
+}
+
+TEST (DarwinSpecies, test0)
+{
+    SpeciesRegistry registry;
+    Species trap;
+    trap.add_instruction(Instruction::IF_ENEMY, 1);
+    trap.add_instruction(Instruction::INFECT);
+
+    ASSERT_EQ(registry.intern("f"), 0);
+    ASSERT_EQ(registry.define("trap", trap), 1);
+    ASSERT_EQ(registry.intern("f"), 0);
+    ASSERT_EQ(registry.find("trap"), 1);
+    ASSERT_EQ(registry.find("rover"), -1);
+    ASSERT_EQ(registry.glyph(1), 't');
+    ASSERT_EQ(registry.name(1), "trap");
+    ASSERT_EQ(registry.get(1).get_program().size(), 2u);
+    ASSERT_EQ(registry.get(0).get_program().size(), 0u);
+}
+
+TEST (DarwinSpecies, test1)
+{
+    Species food, trap;
+    food.add_instruction(Instruction::LEFT);
+    food.add_instruction(Instruction::GO, 0);
+    trap.add_instruction(Instruction::IF_ENEMY, 3);
+    trap.add_instruction(Instruction::LEFT);
+    trap.add_instruction(Instruction::GO, 0);
+    trap.add_instruction(Instruction::INFECT);
+    trap.add_instruction(Instruction::GO, 0);
+
+    Darwin darwin(1, 2);
+    darwin.add_species("f", food);
+    darwin.add_species("t", trap);
+    darwin.add_creature("t", 0, 0, 'e');
+    darwin.add_creature("f", 0, 1, 'n');
+
+    testing::internal::CaptureStdout();
+    darwin.simulate(1, 1, 0, 1);
+    ASSERT_EQ(testing::internal::GetCapturedStdout(),
+              "*** Darwin 1x2 ***\nTurn = 0.\n  01\n0 tf\n\nTurn = 1.\n  01\n0 tt\n");
+
+    // the food got infected and took the trap's id
+    ASSERT_EQ(darwin.get_creature(0, 1)->get_species_id(), darwin.get_species().find("t"));
+    ASSERT_EQ(darwin.get_creature(0, 1)->get_species_type(), "t");
+}
+
+TEST (DarwinBytecode, test0)
+{
+    Species rover;
+    rover.add_instruction(Instruction::IF_ENEMY, 9);
+    rover.add_instruction(Instruction::IF_EMPTY, 7);
+    rover.add_instruction(Instruction::IF_RANDOM, 5);
+    rover.add_instruction(Instruction::LEFT);
+    rover.add_instruction(Instruction::GO, 0);
+    rover.add_instruction(Instruction::RIGHT);
+    rover.add_instruction(Instruction::GO, 0);
+    rover.add_instruction(Instruction::HOP);
+    rover.add_instruction(Instruction::GO, 0);
+    rover.add_instruction(Instruction::INFECT);
+    rover.add_instruction(Instruction::GO, 0);
+
+    Bytecode code = rover.compile();
+    ASSERT_EQ(code.size(), 11);
+    ASSERT_EQ(Bytecode::op(code[0]), Instruction::IF_ENEMY);
+    ASSERT_EQ(Bytecode::taken(code[0]), 9);
+    ASSERT_EQ(Bytecode::next(code[0]), 1);
+
+    // the GO 0 after every action is folded into the action
+    ASSERT_EQ(Bytecode::next(code[3]), 0);
+    ASSERT_EQ(Bytecode::next(code[7]), 0);
+    ASSERT_EQ(Bytecode::taken(code[4]), 0);
+
+    // and the wrap off the end goes back to the top
+    ASSERT_EQ(Bytecode::next(code[10]), 0);
+}
+
+TEST (DarwinBytecode, test1)
+{
+    Species bad;
+    bad.add_instruction(Instruction::IF_WALL, 2);
+    bad.add_instruction(Instruction::LEFT);
+
+    ASSERT_THROW(bad.compile(), out_of_range);
+
+    Darwin darwin(1, 1);
+    ASSERT_THROW(darwin.add_species("b", bad), out_of_range);
+}
+
+TEST (DarwinBytecode, test2)
+{
+    Species hopper, rover;
+    hopper.add_instruction(Instruction::HOP);
+    hopper.add_instruction(Instruction::GO, 0);
+
+    rover.add_instruction(Instruction::IF_ENEMY, 9);
+    rover.add_instruction(Instruction::IF_EMPTY, 7);
+    rover.add_instruction(Instruction::IF_RANDOM, 5);
+    rover.add_instruction(Instruction::LEFT);
+    rover.add_instruction(Instruction::GO, 0);
+    rover.add_instruction(Instruction::RIGHT);
+    rover.add_instruction(Instruction::GO, 0);
+    rover.add_instruction(Instruction::HOP);
+    rover.add_instruction(Instruction::GO, 0);
+    rover.add_instruction(Instruction::INFECT);
+    rover.add_instruction(Instruction::GO, 0);
+
+    // both interpreters have to agree turn for turn
+    string out[2];
+    for (int d = 0; d < 2; d++) {
+        Darwin darwin(6, 6);
+        darwin.set_dispatch(d ? Darwin::THREADED : Darwin::SWITCH);
+        darwin.add_species("h", hopper);
+        darwin.add_species("r", rover);
+        darwin.add_creature("r", 0, 0, 'e');
+        darwin.add_creature("h", 3, 2, 'n');
+        darwin.add_creature("r", 5, 5, 'w');
+        darwin.add_creature("h", 2, 4, 's');
+
+        testing::internal::CaptureStdout();
+        darwin.simulate(40, 1, 0, 1);
+        out[d] = testing::internal::GetCapturedStdout();
+    }
+    ASSERT_EQ(out[0], out[1]);
+}
+
+TEST (DarwinAnalyze, test0)
+{
+    Species rover;
+    rover.add_instruction(Instruction::IF_ENEMY, 9);
+    rover.add_instruction(Instruction::IF_EMPTY, 7);
+    rover.add_instruction(Instruction::IF_RANDOM, 5);
+    rover.add_instruction(Instruction::LEFT);
+    rover.add_instruction(Instruction::GO, 0);
+    rover.add_instruction(Instruction::RIGHT);
+    rover.add_instruction(Instruction::GO, 0);
+    rover.add_instruction(Instruction::HOP);
+    rover.add_instruction(Instruction::GO, 0);
+    rover.add_instruction(Instruction::INFECT);
+    rover.add_instruction(Instruction::GO, 0);
+
+    Species::Analysis analysis = rover.analyze();
+    ASSERT_TRUE(analysis.ok());
+    // IF_ENEMY, IF_EMPTY, IF_RANDOM and then a turn is the long way round
+    ASSERT_EQ(analysis.chain[0], 3);
+    // GO 0 then the same three tests
+    ASSERT_EQ(analysis.chain[4], 4);
+    ASSERT_EQ(analysis.max_chain, 4);
+}
+
+TEST (DarwinAnalyze, test1)
+{
+    Species spin, stuck, wander;
+    spin.add_instruction(Instruction::GO, 0);
+
+    // fine facing a wall, spins forever in the open
+    stuck.add_instruction(Instruction::IF_EMPTY, 0);
+    stuck.add_instruction(Instruction::LEFT);
+
+    // the coin flip never leads anywhere
+    wander.add_instruction(Instruction::IF_RANDOM, 1);
+    wander.add_instruction(Instruction::GO, 0);
+
+    ASSERT_FALSE(spin.analyze().ok());
+    ASSERT_FALSE(stuck.analyze().ok());
+    ASSERT_FALSE(wander.analyze().ok());
+    ASSERT_FALSE(Species().analyze().ok());
+
+    Darwin darwin(2, 2);
+    ASSERT_THROW(darwin.add_species("s", stuck), invalid_argument);
+}
+
+TEST (DarwinAnalyze, test2)
+{
+    Species food;
+    food.add_instruction(Instruction::LEFT);
+    food.add_instruction(Instruction::GO, 0);
+    // never reached, so it doesn't count against the program
+    food.add_instruction(Instruction::GO, 2);
+
+    Species::Analysis analysis = food.analyze();
+    ASSERT_TRUE(analysis.ok());
+    ASSERT_EQ(analysis.chain[2], -1);
+    ASSERT_EQ(analysis.max_chain, 1);
+}
+
+TEST (DarwinParse, test0)
+{
+    Species trap = Species::parse("# trap\nif_enemy 3\nLEFT\n\n  go 0   # back to the top\ninfect\r\ngo 0");
+
+    const vector<Instruction>& program = trap.get_program();
+    ASSERT_EQ(program.size(), 5u);
+    ASSERT_EQ(program[0].type, Instruction::IF_ENEMY);
+    ASSERT_EQ(program[0].param, 3);
+    ASSERT_EQ(program[1].type, Instruction::LEFT);
+    ASSERT_EQ(program[2].type, Instruction::GO);
+    ASSERT_EQ(program[3].type, Instruction::INFECT);
+    ASSERT_EQ(program[4].param, 0);
+}
+
+TEST (DarwinParse, test1)
+{
+    ASSERT_THROW(Species::parse("hop\nskip 2\n"), invalid_argument);
+    ASSERT_THROW(Species::parse("go\n"), invalid_argument);
+    ASSERT_THROW(Species::parse("go x1\n"), invalid_argument);
+    ASSERT_THROW(Species::parse("hop 3\n"), invalid_argument);
+    ASSERT_THROW(Species::parse("go 1 2\n"), invalid_argument);
+    ASSERT_THROW(Species::load("no/such/file.spc"), invalid_argument);
+
+    try {
+        Species::parse("left\n\nhopp\n", "x.spc");
+        FAIL();
+    } catch (const invalid_argument& e) {
+        ASSERT_EQ(string(e.what()), "x.spc:3: unknown instruction \"hopp\"");
+    }
+}
+
+TEST (DarwinParse, test2)
+{
+    Species rover = Species::load("species/r.spc");
+
+    ASSERT_EQ(rover.get_program().size(), 11u);
+    ASSERT_EQ(rover.get_program()[1].type, Instruction::IF_EMPTY);
+    ASSERT_EQ(rover.get_program()[1].param, 7);
+    ASSERT_TRUE(rover.analyze().ok());
+}
+
+TEST (DarwinInput, test0)
+{
+    WorldReader reader("2\n\n3 4\n2\nr 0 1 s\nhopper 2 3 w\n10 5\n\n\n1 1\n0\n7 1\n");
+    WorldSpec spec;
+
+    ASSERT_EQ(reader.size(), 2);
+    ASSERT_TRUE(reader.next(spec));
+    ASSERT_EQ(spec.rows, 3);
+    ASSERT_EQ(spec.cols, 4);
+    ASSERT_EQ(spec.creatures.size(), 2u);
+    ASSERT_EQ(spec.creatures[1].species, "hopper");
+    ASSERT_EQ(spec.creatures[1].row, 2);
+    ASSERT_EQ(spec.creatures[1].col, 3);
+    ASSERT_EQ(spec.creatures[1].dir, 'w');
+    ASSERT_EQ(spec.creatures[1].line, 6);
+    ASSERT_EQ(spec.turns, 10);
+    ASSERT_EQ(spec.freq, 5);
+
+    // the extra blank lines don't matter
+    ASSERT_TRUE(reader.next(spec));
+    ASSERT_EQ(spec.creatures.size(), 0u);
+    ASSERT_EQ(spec.turns, 7);
+    ASSERT_FALSE(reader.next(spec));
+}
+
+TEST (DarwinInput, test1)
+{
+    WorldSpec spec;
+    WorldReader bad_dir("1\n2 2\n1\nf 0 0 x\n1 1\n", "in.txt");
+    try {
+        bad_dir.next(spec);
+        FAIL();
+    } catch (const invalid_argument& e) {
+        ASSERT_EQ(string(e.what()), "in.txt:4: expected a direction (n, e, s or w) but found \"x\"");
+    }
+
+    WorldReader off_board("1\n2 2\n1\nf 2 0 n\n1 1\n");
+    try {
+        off_board.next(spec);
+        FAIL();
+    } catch (const invalid_argument& e) {
+        ASSERT_EQ(string(e.what()), "input:4: expected a row on a 2 row board but found 2");
+    }
+    WorldReader no_freq("1\n2 2\n0\n5 0\n");
+    ASSERT_THROW(no_freq.next(spec), invalid_argument);
+    WorldReader short_input("1\n2 2\n3\nf 0 0 n\n");
+    ASSERT_THROW(short_input.next(spec), invalid_argument);
+    ASSERT_THROW(WorldReader("t\n"), invalid_argument);
+}
+
+TEST (DarwinInput, test2)
+{
+    InputBuffer input = InputBuffer::open("karahphang-Darwin.in.txt");
+    WorldReader reader(input.text());
+    WorldSpec spec;
+
+    ASSERT_EQ(reader.size(), 13);
+    int cases = 0;
+    while (reader.next(spec)) {
+        cases++;
+    }
+    ASSERT_EQ(cases, 13);
+    ASSERT_THROW(InputBuffer::open("no/such/input.txt"), invalid_argument);
+}
+
+TEST (DarwinRender, test0)
+{
+    FrameRenderer renderer(2, 12);
+    memset(renderer.row(0), '.', 12);
+    memset(renderer.row(1), 'h', 12);
+    renderer.row(0)[11] = 'r';
+
+    ASSERT_EQ(renderer.finish(7, true),
+              "Turn = 7.\n  012345678901\n0 ...........r\n1 hhhhhhhhhhhh\n\n");
+    // a longer turn number and no blank line
+    ASSERT_EQ(renderer.finish(1500, false),
+              "Turn = 1500.\n  012345678901\n0 ...........r\n1 hhhhhhhhhhhh\n");
+}
+
+TEST (DarwinRandom, test0)
+{
+    // has to line up with the C library for the expected outputs to hold
+    Random random;
+    srand(0);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(random.next(), rand());
+    }
+    random.seed(42);
+    srand(42);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(random.next(), rand());
+    }
+}
+
+TEST (DarwinBatch, test0)
+{
+    const SpeciesLibrary library = spc_library();
+
+    vector<WorldSpec> specs = read_specs();
+    const string expected = expected_output();
+
+    // the same bytes no matter how many threads share the work
+    for (int jobs : {1, 3, 8}) {
+        RunOptions options;
+        options.jobs = jobs;
+        ostringstream out;
+        run_batch(specs, library, out, options);
+        ASSERT_EQ(out.str(), expected);
+    }
+
+    // named the same way the reader names its own errors
+    specs[0].creatures[0].species = "x";
+    ostringstream out;
+    try {
+        run_batch(specs, library, out);
+        FAIL();
+    } catch (const invalid_argument& e) {
+        ASSERT_EQ(string(e.what()), "karahphang-Darwin.in.txt:" + to_string(specs[0].creatures[0].line) +
+                  ": unknown species \"x\"");
+    }
+}
+
+TEST (DarwinBatch, test1)
+{
+    // case 2 resumes from a broken snapshot. on a worker thread that has to
+    // come back out of run_batch the way it does with one job, after the
+    // cases ahead of it
+    const string dir = testing::TempDir() + "darwin_batch";
+    mkdir(dir.c_str(), 0755);
+    ofstream(dir + "/case2.snap") << "not a snapshot";
+    const vector<WorldSpec> specs = read_specs();
+
+    string out[2];
+    for (int jobs : {1, 4}) {
+        RunOptions options;
+        options.jobs = jobs;
+        options.checkpoint = dir;
+        options.checkpoint_every = 1 << 30;
+        options.resume = true;
+        ostringstream frames;
+        ASSERT_THROW(run_batch(specs, builtin_library(), frames, options), invalid_argument);
+        out[jobs > 1] = frames.str();
+    }
+    ASSERT_EQ(out[1], out[0]);
+    ASSERT_EQ(count(out[0].begin(), out[0].end(), '*'), 2 * 6);  // cases 0 and 1 made it out
+    remove((dir + "/case2.snap").c_str());
+    rmdir(dir.c_str());
+}
+
+TEST (DarwinRandom, test1)
+{
+    Random a(7, Random::FAST), b(7, Random::FAST), c(8, Random::FAST);
+    ASSERT_EQ(a.get_mode(), Random::FAST);
+
+    // a fixed seed always gives the same flips, a different one doesn't
+    int heads = 0, same = 0;
+    for (int i = 0; i < 10000; i++) {
+        const bool flip = a.coin();
+        ASSERT_EQ(flip, b.coin());
+        heads += flip;
+        same += flip == c.coin();
+    }
+    ASSERT_GT(heads, 4700);
+    ASSERT_LT(heads, 5300);
+    ASSERT_LT(same, 5300);
+
+    // one 64 bit draw covers 64 flips
+    Random d(3, Random::FAST), e(3, Random::FAST);
+    const uint64_t word = d.next64();
+    for (int i = 0; i < 64; i++) {
+        ASSERT_EQ(e.coin(), ((word >> i) & 1) != 0);
+    }
+}
+
+TEST (DarwinRandom, test2)
+{
+    Species rover = Species::load("species/r.spc");
+
+    // a reseeded board runs the same every time
+    string out[2];
+    for (int i = 0; i < 2; i++) {
+        Darwin darwin(8, 8);
+        darwin.seed_random(99, Random::FAST);
+        darwin.add_species("r", rover);
+        darwin.add_creature("r", 0, 0, 'e');
+        darwin.add_creature("r", 7, 7, 'w');
+        ostringstream frames;
+        darwin.set_output(frames);
+        darwin.simulate(50, 10, 0, 1);
+        out[i] = frames.str();
+    }
+    ASSERT_EQ(out[0], out[1]);
+}
+
+TEST (DarwinCellSet, test0)
+{
+    CellSet cells(20000);
+    ASSERT_EQ(cells.next(0), -1);
+
+    for (int i : {5, 63, 64, 4095, 4096, 12000, 19999}) {
+        cells.insert(i);
+    }
+    vector<int> found;
+    for (int i = cells.next(0); i >= 0; i = cells.next(i + 1)) {
+        found.push_back(i);
+    }
+    ASSERT_EQ(found, vector<int>({5, 63, 64, 4095, 4096, 12000, 19999}));
+
+    cells.erase(4096);
+    cells.erase(64);
+    ASSERT_FALSE(cells.contains(64));
+    ASSERT_TRUE(cells.contains(63));
+    ASSERT_EQ(cells.next(64), 4095);
+    ASSERT_EQ(cells.next(4096), 12000);
+    ASSERT_EQ(cells.next(20000), -1);
+}
+
+TEST (DarwinCellSet, test1)
+{
+    Species hopper = Species::load("species/h.spc");
+
+    // a lone hopper crossing a big empty board one cell a turn
+    Darwin darwin(200, 200);
+    darwin.add_species("h", hopper);
+    darwin.add_creature("h", 0, 0, 'e');
+    darwin.add_creature("h", 0, 199, 's');
+
+    ostringstream frames;
+    darwin.set_output(frames);
+    darwin.simulate(250, 250, 0, 1);
+
+    // hopping east onto a cell later in the sweep still only counts once
+    ASSERT_NE(darwin.get_creature(0, 199), nullptr);
+    ASSERT_NE(darwin.get_creature(199, 199), nullptr);
+    ASSERT_EQ(darwin.get_creature(0, 0), nullptr);
+}
+
+TEST (DarwinSchedule, test0)
+{
+    Species hopper = Species::load("species/h.spc");
+
+    // a column of hoppers all heading south, each one only gets to go once a
+    // turn even though it lands on a cell the turn hasn't got to yet
+    Darwin darwin(6, 1);
+    darwin.add_species("h", hopper);
+    darwin.add_creature("h", 0, 0, 's');
+    darwin.add_creature("h", 1, 0, 's');
+    darwin.add_creature("h", 3, 0, 's');
+
+    darwin.step();
+    ASSERT_EQ(darwin.get_turn(), 1);
+    // the top one is blocked by the one below it until that one has gone
+    ASSERT_NE(darwin.get_creature(0, 0), nullptr);
+    ASSERT_EQ(darwin.get_creature(1, 0), nullptr);
+    ASSERT_NE(darwin.get_creature(2, 0), nullptr);
+    ASSERT_EQ(darwin.get_creature(3, 0), nullptr);
+    ASSERT_NE(darwin.get_creature(4, 0), nullptr);
+    ASSERT_EQ(darwin.get_creature(5, 0), nullptr);
+}
+
+TEST (DarwinSchedule, test1)
+{
+    Species food = Species::load("species/f.spc");
+    Species trap = Species::load("species/t.spc");
+
+    // the food further along the sweep gets infected and then takes its own
+    // turn as a trap, the food earlier in the sweep already went as food
+    Darwin darwin(1, 3);
+    darwin.add_species("f", food);
+    darwin.add_species("t", trap);
+    darwin.add_creature("f", 0, 0, 'n');
+    darwin.add_creature("t", 0, 1, 'e');
+    darwin.add_creature("f", 0, 2, 's');
+
+    darwin.step();
+    ASSERT_EQ(darwin.get_creature(0, 0)->get_direction(), 'w');
+    ASSERT_EQ(darwin.get_creature(0, 2)->get_species_type(), "t");
+    ASSERT_EQ(darwin.get_creature(0, 2)->get_direction(), 'e');
+}
+
+TEST (DarwinSchedule, test2)
+{
+    const SpeciesLibrary library = spc_library();
+
+    // karahphang-Darwin.out.txt is what the old last_moved_turn engine
+    // printed for karahphang-Darwin.in.txt, check it one test case at a time
+    const vector<WorldSpec> specs = read_specs();
+    const string expected = expected_output();
+
+    size_t at = 0;
+    for (int test = 0; test < static_cast<int>(specs.size()); test++) {
+        ostringstream out;
+        run_world(specs[test], library, out, test, specs.size());
+        ASSERT_EQ(out.str(), expected.substr(at, out.str().size())) << "test case " << test;
+        at += out.str().size();
+    }
+    ASSERT_EQ(at, expected.size());
+}
+
+TEST (DarwinFastForward, test0)
+{
+    const SpeciesLibrary library = spc_library();
+
+    // food only, traps only, and food next to traps that ends up all traps
+    WorldReader reader("3\n"
+                       "5 5\n3\nf 0 0 n\nf 2 3 e\nf 4 4 w\n2000 7\n"
+                       "4 6\n2\nt 1 1 s\nt 3 5 e\n1999 1\n"
+                       "3 3\n3\nt 1 1 e\nf 1 2 n\nf 0 1 s\n1500 13\n");
+    WorldSpec spec;
+    for (int test = 0; reader.next(spec); test++) {
+        string out[2];
+        string directions[2];
+        for (int on = 0; on < 2; on++) {
+            Darwin darwin(spec.rows, spec.cols);
+            darwin.set_fast_forward(on);
+            for (const auto& [name, species] : library) {
+                darwin.add_species(name, species);
+            }
+            for (const WorldSpec::Placement& p : spec.creatures) {
+                darwin.add_creature(string(p.species), p.row, p.col, p.dir);
+            }
+            ostringstream frames;
+            darwin.set_output(frames);
+            darwin.simulate(spec.turns, spec.freq, test, 3);
+            out[on] = frames.str();
+            ASSERT_EQ(darwin.get_turn(), spec.turns);
+            for (const WorldSpec::Placement& p : spec.creatures) {
+                directions[on] += darwin.get_creature(p.row, p.col)->get_direction();
+            }
+        }
+        ASSERT_EQ(out[0], out[1]) << "test case " << test;
+        ASSERT_EQ(directions[0], directions[1]) << "test case " << test;
+    }
+}
+
+TEST (DarwinFastForward, test1)
+{
+    Darwin darwin(2, 2);
+    darwin.add_species("f", Species::load("species/f.spc"));
+    darwin.add_species("t", Species::load("species/t.spc"));
+    darwin.add_species("h", Species::load("species/h.spc"));
+
+    darwin.add_creature("f", 0, 0, 'n');
+    darwin.add_creature("t", 1, 1, 'n');
+    ASSERT_EQ(darwin.get_population(darwin.get_species().find("f")), 1);
+    // a trap with food still around can infect it
+    ASSERT_FALSE(darwin.is_frozen());
+
+    darwin.get_creature(0, 0)->set_species(darwin.get_species().find("t"));
+    ASSERT_EQ(darwin.get_population(darwin.get_species().find("t")), 2);
+    ASSERT_TRUE(darwin.is_frozen());
+
+    // anything that hops keeps the board live
+    darwin.add_creature("h", 0, 1, 'w');
+    ASSERT_FALSE(darwin.is_frozen());
+}
+
+TEST (DarwinCycle, test0)
+{
+    const SpeciesLibrary library = spc_library();
+
+    // hoppers pile up against the walls and traps keep turning, so these all
+    // settle into a loop long before they run out of turns
+    WorldReader reader("3\n"
+                       "4 5\n4\nh 0 0 e\nt 2 2 n\nh 3 4 w\nf 1 3 s\n2000 3\n"
+                       "6 6\n3\nh 5 0 n\nt 0 0 e\nt 5 5 w\n1999 7\n"
+                       "3 7\n5\nh 1 0 e\nh 1 6 w\nt 0 3 s\nf 2 1 n\nh 2 5 n\n1500 1\n");
+    WorldSpec spec;
+    for (int test = 0; reader.next(spec); test++) {
+        string out[2];
+        vector<int> state[2];
+        for (int on = 0; on < 2; on++) {
+            Darwin darwin(spec.rows, spec.cols);
+            darwin.set_fast_forward(false);
+            darwin.set_cycle_detection(on);
+            for (const auto& [name, species] : library) {
+                darwin.add_species(name, species);
+            }
+            for (const WorldSpec::Placement& p : spec.creatures) {
+                darwin.add_creature(string(p.species), p.row, p.col, p.dir);
+            }
+            ostringstream frames;
+            darwin.set_output(frames);
+            darwin.simulate(spec.turns, spec.freq, test, 3);
+            out[on] = frames.str();
+            ASSERT_EQ(darwin.get_turn(), spec.turns);
+            if (on) {
+                ASSERT_GT(darwin.get_cycle_period(), 0) << "test case " << test;
+            }
+
+            // where everyone ended up, not just what got printed
+            const CreatureStore& store = darwin.get_creatures();
+            for (int id = 0; id < store.size(); id++) {
+                state[on].insert(state[on].end(), {store.cell[id], store.species[id], store.direction[id], store.pc[id]});
+            }
+        }
+        ASSERT_EQ(out[0], out[1]) << "test case " << test;
+        ASSERT_EQ(state[0], state[1]) << "test case " << test;
+    }
+}
+
+TEST (DarwinCycle, test1)
+{
+    Darwin darwin(3, 3);
+    darwin.add_species("h", Species::load("species/h.spc"));
+    darwin.add_species("r", Species::load("species/r.spc"));
+    darwin.add_creature("h", 0, 0, 's');
+    darwin.rehash();
+    const uint64_t before = darwin.get_hash();
+
+    // moving changes the hash and moving back restores it
+    darwin.move_creature(0, 0, 1, 0);
+    darwin.rehash();
+    ASSERT_NE(darwin.get_hash(), before);
+    darwin.move_creature(1, 0, 0, 0);
+    darwin.rehash();
+    ASSERT_EQ(darwin.get_hash(), before);
+
+    // a board with a rover on it flips coins so it's never hashed
+    darwin.add_creature("r", 2, 2, 'n');
+    ostringstream frames;
+    darwin.set_output(frames);
+    darwin.simulate(100, 10, 0, 1);
+    ASSERT_EQ(darwin.get_cycle_period(), 0);
+}
+
+TEST (DarwinSpecialize, test0)
+{
+    // the .spc files are the same programs as the built in constants, so
+    // loading them picks up the generated interpreters too
+    const char* names[] = {"f", "h", "r", "t"};
+    const Species builtins[] = {Species(builtin::FOOD), Species(builtin::HOPPER), Species(builtin::ROVER), Species(builtin::TRAP)};
+    for (int i = 0; i < 4; i++) {
+        const Species loaded = Species::load(string("species/") + names[i] + ".spc");
+        const vector<Instruction>& a = loaded.get_program();
+        const vector<Instruction>& b = builtins[i].get_program();
+        ASSERT_EQ(builtin::same_program(a, builtin::FOOD), i == 0);
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t pc = 0; pc < a.size(); pc++) {
+            ASSERT_EQ(a[pc].type, b[pc].type);
+            ASSERT_EQ(a[pc].param, b[pc].param);
+        }
+    }
+    static_assert(builtin::landing(builtin::ROVER, 4) == 0);
+    static_assert(builtin::landing(builtin::TRAP, 2) == 0);
+}
+
+TEST (DarwinSpecialize, test1)
+{
+    const vector<WorldSpec> specs = read_specs();
+    // a rover that also checks for walls has to stay on the bytecode
+    Species careful(builtin::ROVER);
+    careful.add_instruction(Instruction::IF_WALL, 3);
+
+    for (int test = 0; test < static_cast<int>(specs.size()); test++) {
+        const WorldSpec& spec = specs[test];
+        string out[2];
+        vector<int> state[2];
+        for (int d = 0; d < 2; d++) {
+            Darwin darwin(spec.rows, spec.cols);
+            darwin.set_dispatch(d ? Darwin::SPECIALIZED : Darwin::SWITCH);
+            darwin.seed_random(0);
+            darwin.add_species("f", Species(builtin::FOOD));
+            darwin.add_species("h", Species(builtin::HOPPER));
+            darwin.add_species("r", Species(builtin::ROVER));
+            darwin.add_species("t", Species(builtin::TRAP));
+            darwin.add_species("c", careful);
+            for (const WorldSpec::Placement& p : spec.creatures) {
+                darwin.add_creature(string(p.species), p.row, p.col, p.dir);
+            }
+            if (spec.rows > 2 && spec.cols > 2) {
+                darwin.add_creature("c", spec.rows / 2, spec.cols / 2, 'e');
+            }
+            ostringstream frames;
+            darwin.set_output(frames);
+            darwin.simulate(spec.turns, spec.freq, test, specs.size());
+            out[d] = frames.str();
+
+            const CreatureStore& store = darwin.get_creatures();
+            for (int id = 0; id < store.size(); id++) {
+                state[d].insert(state[d].end(), {store.cell[id], store.species[id], store.direction[id], store.pc[id]});
+            }
+        }
+        ASSERT_EQ(out[0], out[1]) << "test case " << test;
+        ASSERT_EQ(state[0], state[1]) << "test case " << test;
+    }
+}
+
+TEST (DarwinWriter, test0)
+{
+    // tiny chunks on a ring of one make the simulation wait on the writer
+    // all the time, none of which can show in the output
+    const WorldSpec spec = read_specs().front();
+    const SpeciesLibrary library = builtin_library();
+
+    ostringstream direct;
+    run_world(spec, library, direct, 0, 1);
+    for (int depth : {1, 3}) {
+        ostringstream written;
+        {
+            FrameWriter writer(written, depth, 7);
+            run_world(spec, library, writer, 0, 1);
+            writer << flush << "x" << 42;
+        }
+        ASSERT_EQ(written.str(), direct.str() + "x42");
+    }
+}
+
+TEST (DarwinWriter, test1)
+{
+    const vector<WorldSpec> specs = read_specs();
+    const SpeciesLibrary library = builtin_library();
+    const string expected = expected_output();
+
+    for (int buffers : {0, 2, 8}) {
+        RunOptions options;
+        options.buffers = buffers;
+        ostringstream out;
+        run_batch(specs, library, out, options);
+        ASSERT_EQ(out.str(), expected) << buffers << " buffers";
+    }
+}
+
+TEST (DarwinSnapshot, test0)
+{
+    auto build = [](Darwin& darwin) {
+        darwin.seed_random(7, Random::FAST);
+        darwin.add_species("f", Species(builtin::FOOD));
+        darwin.add_species("h", Species(builtin::HOPPER));
+        darwin.add_species("r", Species(builtin::ROVER));
+        darwin.add_species("t", Species(builtin::TRAP));
+        darwin.add_creature("r", 0, 0, 'e');
+        darwin.add_creature("h", 3, 2, 'n');
+        darwin.add_creature("t", 5, 5, 'w');
+        darwin.add_creature("f", 2, 4, 's');
+        darwin.add_creature("r", 7, 1, 's');
+        darwin.add_creature("x", 6, 6, 'n');
+    };
+    const string path = testing::TempDir() + "darwin_test.snap";
+
+    Darwin whole(8, 9);
+    build(whole);
+    ostringstream frames;
+    whole.set_output(frames);
+    whole.simulate(1000, 30, 0, 1);
+
+    // the same run with checkpoints along the way has the same output
+    Darwin checked(8, 9);
+    build(checked);
+    ostringstream checked_frames;
+    checked.set_output(checked_frames);
+    checked.set_checkpoint(path, 400);
+    checked.simulate(1000, 30, 0, 1);
+    ASSERT_EQ(checked_frames.str(), frames.str());
+
+    // and picking up from the last one gives the rest of it
+    Darwin resumed(8, 9);
+    resumed.load(path);
+    const int turn = resumed.get_turn();
+    ASSERT_EQ(turn, 800);
+    ASSERT_EQ(resumed.get_species().find("x"), 4);
+    ostringstream rest;
+    resumed.set_output(rest);
+    resumed.resume(1000, 30, 0, 1);
+    const size_t from = frames.str().find("Turn = " + to_string((turn / 30 + 1) * 30) + ".");
+    ASSERT_NE(from, string::npos);
+    ASSERT_EQ(rest.str(), "*** Darwin 8x9 ***\n" + frames.str().substr(from));
+    ASSERT_EQ(resumed.snapshot(), whole.snapshot());
+    remove(path.c_str());
+}
+
+TEST (DarwinSnapshot, test1)
+{
+    Darwin darwin(4, 4);
+    darwin.add_species("h", Species(builtin::HOPPER));
+    darwin.add_creature("h", 1, 1, 'e');
+    darwin.step();
+    const string good = darwin.snapshot();
+
+    Darwin copy(4, 4);
+    copy.restore(good);
+    ASSERT_EQ(copy.snapshot(), good);
+    ASSERT_EQ(copy.get_creature(1, 2)->get_species_type(), "h");
+    ASSERT_EQ(copy.get_creature(1, 2)->get_direction(), 'e');
+
+    // nothing but a whole snapshot of a board the same size gets in
+    string version = good;
+    version[8] = 9;
+    string junk = good + "!";
+    const string bad[] = {"", "DRWNSNAX", good.substr(0, good.size() - 1), version, junk};
+    for (const string& data : bad) {
+        ASSERT_THROW(copy.restore(data), invalid_argument);
+    }
+    Darwin smaller(3, 4);
+    ASSERT_THROW(smaller.restore(good), invalid_argument);
+    ASSERT_THROW(copy.load("no/such/file.snap"), invalid_argument);
+
+    // and a failed one leaves the world the way it was
+    ASSERT_EQ(copy.snapshot(), good);
+}
+
+TEST (DarwinDelta, test0)
+{
+    const vector<WorldSpec> specs = read_specs();
+    const SpeciesLibrary library = builtin_library();
+    const string expected = expected_output();
+
+    RunOptions options;
+    options.format = Darwin::DELTA;
+    ostringstream delta;
+    run_batch(specs, library, delta, options);
+    ASSERT_LT(delta.str().size() * 4, expected.size());
+
+    ostringstream decoded;
+    decode_frames(delta.str(), decoded);
+    ASSERT_EQ(decoded.str(), expected);
+}
+
+TEST (DarwinDelta, test1)
+{
+    // frozen and cycling boards print from their own paths, same deltas
+    Darwin darwin(3, 4);
+    darwin.set_format(Darwin::DELTA);
+    darwin.add_species("h", Species(builtin::HOPPER));
+    darwin.add_species("t", Species(builtin::TRAP));
+    darwin.add_creature("h", 0, 0, 'e');
+    darwin.add_creature("t", 2, 3, 'n');
+    ostringstream frames;
+    darwin.set_output(frames);
+    darwin.simulate(5, 1, 0, 1);
+    ASSERT_EQ(frames.str(),
+              "*** Darwin 3x4 ***\n"
+              "Turn = 0.\n"
+              "  0123\n"
+              "0 h...\n"
+              "1 ....\n"
+              "2 ...t\n"
+              "\n"
+              "Turn = 1. 2\n"
+              "0 0 h .\n"
+              "0 1 . h\n"
+              "\n"
+              "Turn = 2. 2\n"
+              "0 1 h .\n"
+              "0 2 . h\n"
+              "\n"
+              "Turn = 3. 2\n"
+              "0 2 h .\n"
+              "0 3 . h\n"
+              "\n"
+              "Turn = 4. 0\n"
+              "\n"
+              "Turn = 5. 0\n");
+
+    ostringstream decoded;
+    decode_frames(frames.str(), decoded);
+    ASSERT_TRUE(decoded.str().ends_with("\n\nTurn = 5.\n  0123\n0 ...h\n1 ....\n2 ...t\n"));
+
+    ASSERT_THROW(decode_frames("Turn = 1. 0\n", decoded), invalid_argument);
+    ASSERT_THROW(decode_frames("*** Darwin 1x1 ***\nTurn = 0.\n  0\n0 .\n\nTurn = 1. 1\n0 0 h .\n", decoded), invalid_argument);
+}
+
+TEST (DarwinDelta, test2)
+{
+    // a resumed batch still starts every case with its header, so its deltas
+    // decode to the same thing the resumed batch prints as text
+    const string dir = testing::TempDir() + "darwin_delta";
+    mkdir(dir.c_str(), 0755);
+    const vector<WorldSpec> specs = read_specs();
+    RunOptions options;
+    options.format = Darwin::DELTA;
+    options.checkpoint = dir;
+    options.checkpoint_every = 50;
+    ostringstream full;
+    run_batch(specs, builtin_library(), full, options);
+
+    options.resume = true;
+    options.checkpoint_every = 1 << 30;
+    ostringstream delta, text;
+    run_batch(specs, builtin_library(), delta, options);
+    options.format = Darwin::TEXT;
+    run_batch(specs, builtin_library(), text, options);
+
+    ostringstream decoded;
+    decode_frames(delta.str(), decoded);
+    ASSERT_EQ(decoded.str(), text.str());
+    ASSERT_LT(text.str().size(), expected_output().size());
+    size_t headers = 0;
+    for (size_t at = text.str().find("*** Darwin"); at != string::npos; at = text.str().find("*** Darwin", at + 1)) {
+        headers++;
+    }
+    ASSERT_EQ(headers, specs.size());
+    for (size_t test = 0; test < specs.size(); test++) {
+        remove((dir + "/case" + to_string(test) + ".snap").c_str());
+    }
+    rmdir(dir.c_str());
+}
+
+TEST (DarwinStats, test0)
+{
+    // a hopper runs into the wall after two hops, a trap eats the food
+    Darwin darwin(3, 4);
+    darwin.add_species("f", Species(builtin::FOOD));
+    darwin.add_species("h", Species(builtin::HOPPER));
+    darwin.add_species("t", Species(builtin::TRAP));
+    darwin.add_creature("h", 0, 1, 'e');
+    darwin.add_creature("t", 2, 0, 'e');
+    darwin.add_creature("f", 2, 1, 'n');
+    darwin.set_fast_forward(false);
+    darwin.set_cycle_detection(false);
+    ostringstream frames;
+    darwin.set_output(frames);
+    darwin.simulate(4, 4, 0, 1);
+
+    const Stats stats = darwin.get_stats();
+    ASSERT_EQ(stats.actions, 12u);
+    ASSERT_EQ(stats.ops[Instruction::HOP], 4u);
+    ASSERT_EQ(stats.hops_blocked, 2u);
+    ASSERT_EQ(stats.infections, 1u);
+    ASSERT_EQ(stats.species, vector<string>({"f", "h", "t"}));
+    ASSERT_EQ(stats.first_turn, 1);
+    ASSERT_EQ(stats.population.size(), 4u);
+    ASSERT_EQ(stats.population[0], vector<int>({0, 1, 2}));
+
+    // names that would break a CSV row or a JSON string get quoted
+    Stats named = stats;
+    named.species = {"f,1", "h\"2", "t\\3"};
+    ostringstream csv, json;
+    write_stats(csv, {named}, false);
+    write_stats(json, {named}, true);
+    ASSERT_NE(csv.str().find("\n0,1,\"f,1\",0\n0,1,\"h\"\"2\",1\n"), string::npos);
+    ASSERT_NE(json.str().find("{\"f,1\": [0, 0, 0, 0], \"h\\\"2\": [1, 1, 1, 1], \"t\\\\3\": ["), string::npos);
+}
+
+TEST (DarwinStats, test1)
+{
+    const vector<WorldSpec> specs = read_specs();
+    const SpeciesLibrary library = builtin_library();
+
+    // the counts don't depend on how many threads ran the cases, and every
+    // case has a population for each of its turns, skipped ones included
+    vector<Stats> stats[2];
+    for (int jobs : {1, 3}) {
+        RunOptions options;
+        options.jobs = jobs;
+        options.stats = &stats[jobs > 1];
+        ostringstream out;
+        run_batch(specs, library, out, options);
+    }
+    ASSERT_EQ(stats[0].size(), specs.size());
+    for (size_t test = 0; test < specs.size(); test++) {
+        ASSERT_EQ(stats[0][test].actions, stats[1][test].actions);
+        ASSERT_EQ(stats[0][test].instructions(), stats[1][test].instructions());
+        ASSERT_EQ(stats[0][test].population, stats[1][test].population);
+        ASSERT_EQ(static_cast<int>(stats[0][test].population.size()), specs[test].turns);
+    }
+
+    ostringstream csv, json;
+    write_stats(csv, stats[0], false);
+    write_stats(json, stats[0], true);
+    ASSERT_EQ(csv.str().rfind("case,turn,name,value\n", 0), 0u);
+    ASSERT_NE(csv.str().find("\nall,,if_random,"), string::npos);
+    ASSERT_NE(json.str().find("\"all\": {\"actions\": "), string::npos);
+}
+
+TEST (DarwinStats, test2)
+{
+    // fast forward and cycle detection are on by default, the turns they skip
+    // have to count the same as running them
+    auto run = [](int board, bool skipping, int& period) {
+        Darwin darwin(3, 3);
+        darwin.add_species("f", Species(builtin::FOOD));
+        darwin.add_species("h", Species(builtin::HOPPER));
+        darwin.add_species("c", Species::parse("hop\nright\ngo 0\n"));
+        if (board == 0) {
+            darwin.add_creature("f", 0, 0, 'e');
+            darwin.add_creature("f", 2, 2, 'w');
+        } else if (board == 1) {
+            darwin.add_creature("h", 1, 2, 'e');
+        } else {
+            darwin.add_creature("c", 0, 0, 'e');
+        }
+        darwin.set_fast_forward(skipping);
+        darwin.set_cycle_detection(skipping);
+        ostringstream frames;
+        darwin.set_output(frames);
+        darwin.simulate(2000, 100, 0, 1);
+        period = darwin.get_cycle_period();
+        return darwin.get_stats();
+    };
+
+    for (int board = 0; board < 3; board++) {
+        int period, unused;
+        const Stats skipped = run(board, true, period);
+        const Stats every = run(board, false, unused);
+        for (int op = 0; op <= Instruction::GO; op++) {
+            ASSERT_EQ(skipped.ops[op], every.ops[op]) << "board " << board << ", " << Instruction::NAMES[op];
+        }
+        ASSERT_EQ(skipped.actions, every.actions) << "board " << board;
+        ASSERT_EQ(skipped.hops_blocked, every.hops_blocked) << "board " << board;
+        ASSERT_EQ(skipped.population, every.population) << "board " << board;
+        if (board == 0) {
+            ASSERT_EQ(skipped.actions, 4000u);
+        } else if (board == 1) {
+            ASSERT_EQ(skipped.hops_blocked, 2000u);
+        } else {
+            ASSERT_GT(period, 0);
+            ASSERT_EQ(skipped.hops_blocked, 0u);
+        }
+    }
+}
+
+TEST (DarwinBanded, test0)
+{
+    // crowded boards so plenty of creatures sit on band edges, every thread
+    // count has to leave everything exactly where one thread does
+    for (Random::Mode mode : {Random::KEYED, Random::COMPATIBLE}) {
+        for (int size : {8, 23, 40}) {
+            string out[4];
+            string state[4];
+            for (int threads = 1; threads <= 4; threads++) {
+                Darwin darwin(size, size + 3);
+                darwin.set_threads(threads);
+                darwin.seed_random(size, mode);
+                darwin.add_species("f", Species(builtin::FOOD));
+                darwin.add_species("h", Species(builtin::HOPPER));
+                darwin.add_species("r", Species(builtin::ROVER));
+                darwin.add_species("t", Species(builtin::TRAP));
+                Random place(size);
+                for (int i = 0; i < size; i++) {
+                    for (int j = 0; j < size + 3; j++) {
+                        if (place.next() % 3) {
+                            // no rovers for COMPATIBLE, so the bands still get used
+                            const int sp = place.next() % (mode == Random::KEYED ? 4 : 3);
+                            darwin.add_creature(string(1, "fhtr"[sp]), i, j, "nesw"[place.next() % 4]);
+                        }
+                    }
+                }
+                ostringstream frames;
+                darwin.set_output(frames);
+                darwin.simulate(60, 7, 0, 1);
+                out[threads - 1] = frames.str();
+                state[threads - 1] = darwin.snapshot();
+            }
+            for (int t = 1; t < 4; t++) {
+                ASSERT_EQ(out[t], out[0]) << size << " with " << t + 1 << " threads";
+                ASSERT_EQ(state[t], state[0]) << size << " with " << t + 1 << " threads";
+            }
+        }
+    }
+}
+
+TEST (DarwinBanded, test1)
+{
+    // KEYED flips depend on the turn and the creature, not on who went first
+    Random a(5, Random::KEYED), b(5, Random::KEYED);
+    a.key(3, 10);
+    const bool first = a.coin();
+    a.key(3, 11);
+    a.coin();
+    b.key(3, 11);
+    b.coin();
+    b.key(3, 10);
+    ASSERT_EQ(b.coin(), first);
+    ASSERT_EQ(a.get_flips(), b.get_flips());
+
+    // the batch runner passes the thread count on
+    RunOptions options;
+    options.threads = 3;
+    ostringstream out;
+    run_batch(read_specs(), builtin_library(), out, options);
+    ASSERT_EQ(out.str(), expected_output());
+}
+
+TEST (DarwinSynchronous, test0)
+{
+    // nobody sees a cell emptied earlier in the turn, and the first of two
+    // hoppers after the same cell gets it
+    Darwin darwin(3, 3);
+    darwin.set_update(Darwin::SYNCHRONOUS);
+    darwin.add_species("h", Species(builtin::HOPPER));
+    darwin.add_creature("h", 0, 0, 'e');
+    darwin.add_creature("h", 0, 2, 'w');
+    darwin.add_creature("h", 1, 1, 'w');
+    darwin.add_creature("h", 1, 2, 'w');
+    darwin.step();
+    ASSERT_NE(darwin.get_creature(0, 1), nullptr);
+    ASSERT_EQ(darwin.get_creature(0, 0), nullptr);
+    ASSERT_NE(darwin.get_creature(0, 2), nullptr);
+    ASSERT_NE(darwin.get_creature(1, 0), nullptr);
+    ASSERT_EQ(darwin.get_creature(1, 1), nullptr);
+    ASSERT_NE(darwin.get_creature(1, 2), nullptr);
+    ASSERT_EQ(darwin.get_turn(), 1);
+}
+
+TEST (DarwinSynchronous, test1)
+{
+    // a infects b first, so b's own infections go nowhere: not back at a,
+    // and not on to the food it had in front of it
+    Darwin darwin(2, 3);
+    darwin.set_update(Darwin::SYNCHRONOUS);
+    darwin.add_species("a", Species(builtin::TRAP));
+    darwin.add_species("b", Species(builtin::TRAP));
+    darwin.add_species("f", Species(builtin::FOOD));
+    darwin.add_creature("a", 0, 0, 'e');
+    darwin.add_creature("b", 0, 1, 'e');
+    darwin.add_creature("f", 0, 2, 'n');
+    darwin.add_creature("b", 1, 0, 'e');
+    darwin.add_creature("a", 1, 1, 'w');
+    darwin.step();
+    ASSERT_EQ(darwin.get_creature(0, 1)->get_species_type(), "a");
+    ASSERT_EQ(darwin.get_creature(0, 2)->get_species_type(), "f");
+    ASSERT_EQ(darwin.get_creature(1, 0)->get_species_type(), "b");
+    ASSERT_EQ(darwin.get_creature(1, 1)->get_species_type(), "b");
+    ASSERT_EQ(darwin.get_population(0), 2);
+    ASSERT_EQ(darwin.get_population(1), 2);
+
+    // every creature decides on its own, so threads don't change anything
+    string state[2];
+    for (int threads : {1, 3}) {
+        Darwin world(30, 30);
+        world.set_update(Darwin::SYNCHRONOUS);
+        world.set_threads(threads);
+        world.seed_random(9, Random::KEYED);
+        world.add_species("h", Species(builtin::HOPPER));
+        world.add_species("r", Species(builtin::ROVER));
+        world.add_species("t", Species(builtin::TRAP));
+        Random place(9);
+        for (int i = 0; i < 30; i++) {
+            for (int j = 0; j < 30; j++) {
+                if (place.next() % 2) {
+                    world.add_creature(string(1, "hrt"[place.next() % 3]), i, j, "nesw"[place.next() % 4]);
+                }
+            }
+        }
+        ostringstream frames;
+        world.set_output(frames);
+        world.simulate(50, 10, 0, 1);
+        state[threads / 3] = frames.str() + world.snapshot();
+    }
+    ASSERT_EQ(state[1], state[0]);
+}
+
+TEST (DarwinKernels, test0)
+{
+    // the vector paths have to agree with the scalar ones, tails included
+    Random random(11);
+    for (int n : {0, 5, 31, 32, 33, 64, 100}) {
+        vector<uint8_t> here(n), ahead(n);
+        for (int j = 0; j < n; j++) {
+            here[j] = static_cast<uint8_t>(random.next() % 4);
+            const int a = random.next() % 6;
+            ahead[j] = a == 5 ? kernels::WALL_CODE : static_cast<uint8_t>(a);
+        }
+        vector<uint8_t> fast(n), slow(n);
+        kernels::sense_row(here.data(), ahead.data(), n, fast.data());
+        kernels::sense_row_scalar(here.data(), ahead.data(), n, slow.data());
+        ASSERT_EQ(fast, slow) << n;
+
+        char palette[256] = {'.', 'f', 'h', 'r'};
+        string a(n, ' '), b(n, ' ');
+        kernels::glyph_row(here.data(), n, palette, 4, a.data());
+        kernels::glyph_row_scalar(here.data(), n, palette, b.data());
+        ASSERT_EQ(a, b) << n;
+    }
+    const uint8_t here[] = {1, 1, 2, 0};
+    const uint8_t ahead[] = {kernels::WALL_CODE, 0, 1, 3};
+    uint8_t out[4];
+    kernels::sense_row(here, ahead, 4, out);
+    ASSERT_EQ(out[0], kernels::WALL);
+    ASSERT_EQ(out[1], kernels::EMPTY);
+    ASSERT_EQ(out[2], kernels::ENEMY);
+    ASSERT_EQ(out[3], kernels::ENEMY);
+}
+
+TEST (DarwinKernels, test1)
+{
+    // the byte board keeps up through moves, infections and a restore, and
+    // past the species a byte can name printing falls back to the grid
+    for (int extra : {0, 300}) {
+        Darwin darwin(2, 40);
+        for (int sp = 0; sp < extra; sp++) {
+            darwin.add_species(to_string(sp), Species(builtin::FOOD));
+        }
+        darwin.add_species("h", Species(builtin::HOPPER));
+        darwin.add_species("t", Species(builtin::TRAP));
+        darwin.add_creature("h", 0, 0, 'e');
+        darwin.add_creature("t", 1, 39, 'w');
+        darwin.add_creature("h", 1, 37, 'e');
+        darwin.move_creature(0, 0, 0, 35);
+        const string saved = darwin.snapshot();
+        ostringstream out;
+        darwin.set_output(out);
+        darwin.simulate(2, 1, 0, 1);
+        darwin.restore(saved);
+        darwin.simulate(0, 1, 0, 1);
+        ASSERT_EQ(out.str(),
+                  "*** Darwin 2x40 ***\nTurn = 0.\n  0123456789012345678901234567890123456789\n"
+                  "0 ...................................h....\n1 .....................................h.t\n\n"
+                  "Turn = 1.\n  0123456789012345678901234567890123456789\n"
+                  "0 ....................................h...\n1 ......................................tt\n\n"
+                  "Turn = 2.\n  0123456789012345678901234567890123456789\n"
+                  "0 .....................................h..\n1 ......................................tt\n"
+                  "*** Darwin 2x40 ***\nTurn = 0.\n  0123456789012345678901234567890123456789\n"
+                  "0 ...................................h....\n1 .....................................h.t\n\n");
+    }
+}